@@ -0,0 +1,92 @@
+// Vec2FieldSystem::update on a 512x512 grid of arrows, the size the field is meant to reach at
+// 60 Hz, with a few body counts orbiting through it. Full recomputes and lazy updates are timed on
+// the calling thread and on a JobSystem with every hardware thread.
+// Usage: field_bench [frames]
+#include "Vec2FieldSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace kopi;
+
+static constexpr float STRENGTH       = 0.81f;
+static constexpr float FRAME_DELTA    = 1.0f / 60;
+static constexpr int GRID_SIZE        = 512;
+static constexpr size_t BODY_COUNTS[] = {2, 16, 128};
+
+// bodies on circles about the origin, each at its own radius and speed
+static void placeBodies(World &world, int frame) {
+  size_t b = 0;
+  for (auto chunk : world.view<Transform2dComponent, RigidBody2dComponent>()) {
+    auto transforms = chunk.get<Transform2dComponent>();
+    for (size_t row = 0; row < chunk.size(); row++, b++) {
+      const float radius          = 0.2f + 0.6f * std::fmod(0.618f * b, 1.0f);
+      const float angle           = (0.5f + 0.1f * b) * FRAME_DELTA * frame + b;
+      transforms[row].translation = {radius * std::cos(angle), radius * std::sin(angle)};
+    }
+  }
+}
+
+static void createScene(World &world, size_t bodyCount) {
+  for (size_t b = 0; b < bodyCount; b++) {
+    world.create(Transform2dComponent{}, RigidBody2dComponent{{}, 1.0f / bodyCount});
+  }
+  placeBodies(world, 0);
+  for (int i = 0; i < GRID_SIZE; i++) {
+    for (int j = 0; j < GRID_SIZE; j++) {
+      Transform2dComponent sample{};
+      sample.translation = {-1.0f + (i + 0.5f) * 2.0f / GRID_SIZE,
+                            -1.0f + (j + 0.5f) * 2.0f / GRID_SIZE};
+      world.create(sample, ColourComponent{}, FieldSampleComponent{});
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  const int frames = argc > 1 ? std::atoi(argv[1]) : 120;
+  const unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  JobSystem jobs{hardwareThreads};
+
+  std::printf("%dx%d samples, %d frames, 60 Hz leaves %.2f ms\n",
+              GRID_SIZE,
+              GRID_SIZE,
+              frames,
+              FRAME_DELTA * 1000.0f);
+  std::printf("%8s %6s %8s %12s %12s\n", "bodies", "lazy", "threads", "ms/frame", "tiles/frame");
+  for (size_t bodyCount : BODY_COUNTS) {
+    World world;
+    createScene(world, bodyCount);
+    for (bool lazy : {false, true}) {
+      for (JobSystem *jobSystem : {static_cast<JobSystem *>(nullptr), &jobs}) {
+        Vec2FieldSystem field;
+        field.lazyUpdates = lazy;
+        field.jobSystem   = jobSystem;
+        // the first update builds the tiles and shades everything, it is left out
+        placeBodies(world, 0);
+        field.update(STRENGTH, world);
+        const uint64_t firstTiles = field.tileEvaluations();
+
+        double elapsed = 0.0;
+        for (int frame = 1; frame <= frames; frame++) {
+          placeBodies(world, frame);
+          const auto start = std::chrono::steady_clock::now();
+          field.update(STRENGTH, world);
+          elapsed += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                               start)
+                         .count();
+        }
+        std::printf("%8zu %6s %8u %12.2f %12.0f\n",
+                    bodyCount,
+                    lazy ? "yes" : "no",
+                    jobSystem != nullptr ? jobSystem->threadCount() : 1u,
+                    elapsed / frames,
+                    double(field.tileEvaluations() - firstTiles) / frames);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+// Energy drift of each integrator against the force evaluations it spends, on the demo's two-body
+// orbit and on the three-body figure-eight, then of block timesteps against fixed leapfrog steps on
+// a swarm clustered around one heavy body. Every configuration simulates the same span at
+// 60 frames per second. Usage: integrator_drift_bench [seconds]
+#include "GravityPhysicsSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numbers>
+#include <random>
+#include <span>
+
+using namespace kopi;
+
+static constexpr float STRENGTH    = 0.81f;
+static constexpr float FRAME_DELTA = 1.0f / 60;
+
+static constexpr size_t CLUSTERED_BODY_COUNT = 128;
+
+struct Config {
+  const char *name;
+  Integrator integrator;
+  unsigned int substeps;
+  bool adaptive = false;
+};
+
+static constexpr Config CONFIGS[] = {
+    {"euler",    Integrator::SemiImplicitEuler, 1 },
+    {"euler",    Integrator::SemiImplicitEuler, 5 },
+    {"euler",    Integrator::SemiImplicitEuler, 20},
+    {"leapfrog", Integrator::Leapfrog,          1 },
+    {"leapfrog", Integrator::Leapfrog,          2 },
+    {"leapfrog", Integrator::Leapfrog,          5 },
+    {"yoshida4", Integrator::Yoshida4,          1 },
+    {"yoshida4", Integrator::Yoshida4,          2 },
+};
+
+// adaptive rows use GravityPhysicsSystem's default maxRung and eta
+static constexpr Config CLUSTERED_CONFIGS[] = {
+    {"leapfrog", Integrator::Leapfrog, 1 },
+    {"leapfrog", Integrator::Leapfrog, 4 },
+    {"leapfrog", Integrator::Leapfrog, 16},
+    {"leapfrog", Integrator::Leapfrog, 64},
+    {"adaptive", Integrator::Leapfrog, 1,  true},
+    {"adaptive", Integrator::Leapfrog, 4,  true},
+};
+
+// the two bodies Application::run starts with
+static BodyStore twoBodyScene() {
+  BodyStore bodies;
+  bodies.resize(2);
+  bodies.posX[0] = 0.5f;
+  bodies.posY[0] = 0.5f;
+  bodies.velX[0] = -0.5f;
+  bodies.mass[0] = 1.0f;
+  bodies.posX[1] = -0.45f;
+  bodies.posY[1] = -0.25f;
+  bodies.velX[1] = 0.5f;
+  bodies.mass[1] = 1.0f;
+  return bodies;
+}
+
+// Chenciner and Montgomery's figure-eight, three equal masses chasing each other along one curve
+// with repeated close passes. Velocities are scaled for STRENGTH instead of G = 1.
+static BodyStore figureEightScene() {
+  const float x  = 0.97000436f;
+  const float y  = -0.24308753f;
+  const float vx = -0.93240737f * std::sqrt(STRENGTH);
+  const float vy = -0.86473146f * std::sqrt(STRENGTH);
+  const float posX[] = {x, -x, 0.0f};
+  const float posY[] = {y, -y, 0.0f};
+  const float velX[] = {-0.5f * vx, -0.5f * vx, vx};
+  const float velY[] = {-0.5f * vy, -0.5f * vy, vy};
+  BodyStore bodies;
+  bodies.resize(3);
+  for (size_t i = 0; i < 3; i++) {
+    bodies.posX[i] = posX[i];
+    bodies.posY[i] = posY[i];
+    bodies.velX[i] = velX[i];
+    bodies.velY[i] = velY[i];
+    bodies.mass[i] = 1.0f;
+  }
+  return bodies;
+}
+
+// A swarm of light bodies on eccentric orbits around one heavy body. Pericentre passes need far
+// shorter steps than the rest of each orbit, and only a few bodies are near pericentre at a time.
+// The swarm is light enough that its own close passes barely move the total energy.
+static BodyStore clusteredScene() {
+  std::mt19937 random{11};
+  std::uniform_real_distribution<float> semiMajorAxis{0.2f, 0.9f};
+  std::uniform_real_distribution<float> eccentricity{0.0f, 0.9f};
+  std::uniform_real_distribution<float> angle{0.0f, 2.0f * std::numbers::pi_v<float>};
+  BodyStore bodies;
+  bodies.resize(CLUSTERED_BODY_COUNT);
+  bodies.mass[0] = 1.0f;
+  for (size_t i = 1; i < CLUSTERED_BODY_COUNT; i++) {
+    // every body starts at apocentre
+    const float a         = semiMajorAxis(random);
+    const float e         = eccentricity(random);
+    const float direction = angle(random);
+    const float distance  = a * (1.0f + e);
+    const float speed     = std::sqrt(STRENGTH * (1.0f - e) / distance);
+    bodies.posX[i]        = distance * std::cos(direction);
+    bodies.posY[i]        = distance * std::sin(direction);
+    bodies.velX[i]        = -speed * std::sin(direction);
+    bodies.velY[i]        = speed * std::cos(direction);
+    bodies.mass[i]        = 1e-6f;
+  }
+  return bodies;
+}
+
+static void run(const char *sceneName,
+                const BodyStore &scene,
+                float seconds,
+                std::span<const Config> configs) {
+  const int frames = static_cast<int>(seconds / FRAME_DELTA);
+  std::printf("\n%s, %zu bodies, %.0f s at 60 Hz\n", sceneName, scene.size(), seconds);
+  std::printf("%-10s %8s %12s %14s %14s %10s\n",
+              "integrator",
+              "substeps",
+              "evals/frame",
+              "max |dE/E|",
+              "final |dE/E|",
+              "ms");
+
+  for (const Config &config : configs) {
+    GravityPhysicsSystem gravity{STRENGTH};
+    gravity.integrator        = config.integrator;
+    gravity.adaptiveTimesteps = config.adaptive;
+    BodyStore bodies          = scene;
+
+    const double initial = gravity.totalEnergy(bodies);
+    double worst         = 0.0;
+    double drift         = 0.0;
+    double elapsed       = 0.0;
+    for (int frame = 0; frame < frames; frame++) {
+      const auto start = std::chrono::steady_clock::now();
+      gravity.update(bodies, FRAME_DELTA, config.substeps);
+      elapsed += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                     .count();
+      // energy is summed outside the timed part, it costs more than the step itself
+      drift = std::abs((gravity.totalEnergy(bodies) - initial) / initial);
+      worst = std::max(worst, drift);
+    }
+
+    const double evalsPerFrame =
+        static_cast<double>(gravity.forceEvaluations()) / (double(frames) * scene.size());
+    std::printf("%-10s %8u %12.2f %14.2e %14.2e %10.2f\n",
+                config.name,
+                config.substeps,
+                evalsPerFrame,
+                worst,
+                drift,
+                elapsed);
+  }
+}
+
+int main(int argc, char **argv) {
+  const float seconds = argc > 1 ? std::strtof(argv[1], nullptr) : 30.0f;
+  run("two-body orbit", twoBodyScene(), seconds, CONFIGS);
+  run("figure-eight", figureEightScene(), seconds, CONFIGS);
+  run("clustered", clusteredScene(), seconds, CLUSTERED_CONFIGS);
+  return 0;
+}
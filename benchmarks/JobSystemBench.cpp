@@ -0,0 +1,84 @@
+// Scheduling overhead of the JobSystem: empty jobs so only the scheduler is measured. Reports the
+// cost of an independent job from schedule to wait, of each link in a dependency chain, and of an
+// empty parallelFor over 64 ranges, for each thread count up to the hardware's.
+// Usage: job_system_bench [iterations]
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace kopi;
+
+static constexpr size_t BATCH_SIZE     = 256; // jobs in flight at once for the independent case
+static constexpr size_t CHAIN_LENGTH   = 64;
+static constexpr size_t PARALLEL_RANGE = 64;
+
+using Clock = std::chrono::steady_clock;
+
+static double nanoseconds(Clock::time_point start, size_t operations) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / operations;
+}
+
+static double independentJobs(JobSystem &jobs, size_t iterations) {
+  std::vector<JobHandle> batch;
+  batch.reserve(BATCH_SIZE);
+  const size_t batches = std::max<size_t>(iterations / BATCH_SIZE, 1);
+  const auto start     = Clock::now();
+  for (size_t b = 0; b < batches; b++) {
+    batch.clear();
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+      batch.push_back(jobs.schedule([] {}));
+    }
+    jobs.wait(batch);
+  }
+  return nanoseconds(start, batches * BATCH_SIZE);
+}
+
+static double dependencyChain(JobSystem &jobs, size_t iterations) {
+  const size_t chains = std::max<size_t>(iterations / CHAIN_LENGTH, 1);
+  const auto start    = Clock::now();
+  for (size_t c = 0; c < chains; c++) {
+    JobHandle previous;
+    for (size_t i = 0; i < CHAIN_LENGTH; i++) {
+      previous = jobs.schedule([] {}, {previous});
+    }
+    jobs.wait(previous);
+  }
+  return nanoseconds(start, chains * CHAIN_LENGTH);
+}
+
+static double emptyParallelFor(JobSystem &jobs, size_t iterations) {
+  const size_t calls = std::max<size_t>(iterations / PARALLEL_RANGE, 1);
+  const auto start   = Clock::now();
+  for (size_t c = 0; c < calls; c++) {
+    jobs.parallelFor(PARALLEL_RANGE, 1, [](size_t, size_t) {});
+  }
+  return nanoseconds(start, calls);
+}
+
+int main(int argc, char **argv) {
+  const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+  const unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  std::printf("%u hardware threads, %zu jobs per measurement\n", hardwareThreads, iterations);
+  std::printf("%8s %18s %16s %22s\n",
+              "threads",
+              "independent (ns)",
+              "chain link (ns)",
+              "parallelFor 64 (ns)");
+  for (unsigned int threads = 1; threads <= std::max(hardwareThreads, 4u); threads *= 2) {
+    JobSystem jobs{threads};
+    // one untimed round so the workers are up and the deques have grown
+    independentJobs(jobs, BATCH_SIZE);
+    std::printf("%8u %18.1f %16.1f %22.1f\n",
+                threads,
+                independentJobs(jobs, iterations),
+                dependencyChain(jobs, iterations),
+                emptyParallelFor(jobs, iterations));
+  }
+  return 0;
+}
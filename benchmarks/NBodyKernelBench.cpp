@@ -0,0 +1,132 @@
+// Direct-sum kernel throughput at 1k, 4k and 16k bodies on one thread, against the symmetric
+// pair loop GravityPhysicsSystem used before the SoA kernel. The kernel's instruction set is
+// fixed when NBodyKernel.cpp is compiled, so every variant is its own executable:
+// nbody_kernel_bench_scalar, _sse2 and _avx2. Usage: nbody_kernel_bench_<isa> [seconds]
+#include "NBodyKernel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace kopi;
+
+static constexpr float STRENGTH             = 0.81f;
+static constexpr size_t BODY_COUNTS[]       = {1024, 4096, 16384};
+static constexpr float MIN_DISTANCE_SQUARED = 1e-10f;
+
+using Clock = std::chrono::steady_clock;
+
+struct Scene {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> mass;
+};
+
+static Scene randomScene(size_t count) {
+  std::mt19937 random{static_cast<uint32_t>(count)};
+  std::uniform_real_distribution<float> position{-1.0f, 1.0f};
+  std::uniform_real_distribution<float> mass{0.5f, 2.0f};
+  Scene scene;
+  for (size_t i = 0; i < count; i++) {
+    scene.x.push_back(position(random));
+    scene.y.push_back(position(random));
+    scene.mass.push_back(mass(random) / count);
+  }
+  return scene;
+}
+
+// every pair once, each force applied to both bodies, like the pre-SoA update loop
+static void pairLoop(const Scene &scene, float *accX, float *accY) {
+  const size_t count = scene.x.size();
+  std::fill(accX, accX + count, 0.0f);
+  std::fill(accY, accY + count, 0.0f);
+  for (size_t i = 0; i < count; i++) {
+    for (size_t j = i + 1; j < count; j++) {
+      const float dx              = scene.x[j] - scene.x[i];
+      const float dy              = scene.y[j] - scene.y[i];
+      const float distanceSquared = dx * dx + dy * dy;
+      if (distanceSquared < MIN_DISTANCE_SQUARED) {
+        continue;
+      }
+      const float invCube = 1.0f / (distanceSquared * std::sqrt(distanceSquared));
+      accX[i] += scene.mass[j] * invCube * dx;
+      accY[i] += scene.mass[j] * invCube * dy;
+      accX[j] -= scene.mass[i] * invCube * dx;
+      accY[j] -= scene.mass[i] * invCube * dy;
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    accX[i] *= STRENGTH;
+    accY[i] *= STRENGTH;
+  }
+}
+
+static void kernel(const Scene &scene, float *accX, float *accY) {
+  const size_t count = scene.x.size();
+  directSumAccelerations(scene.x.data(),
+                         scene.y.data(),
+                         count,
+                         scene.x.data(),
+                         scene.y.data(),
+                         scene.mass.data(),
+                         count,
+                         STRENGTH,
+                         accX,
+                         accY);
+}
+
+// milliseconds per call, repeated until seconds have passed
+template <typename Fn>
+static double timeMs(float seconds, Fn &&fn) {
+  size_t calls     = 0;
+  const auto start = Clock::now();
+  double elapsed   = 0.0;
+  do {
+    fn();
+    calls++;
+    elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  } while (elapsed < seconds * 1000.0);
+  return elapsed / calls;
+}
+
+int main(int argc, char **argv) {
+  const float seconds = argc > 1 ? std::strtof(argv[1], nullptr) : 1.0f;
+
+  std::printf("kernel: %s, single thread\n", directSumKernelName());
+  std::printf("%8s %14s %14s %16s %10s %14s\n",
+              "bodies",
+              "pair loop ms",
+              "kernel ms",
+              "ns/interaction",
+              "speedup",
+              "max rel error");
+  for (size_t count : BODY_COUNTS) {
+    const Scene scene = randomScene(count);
+    std::vector<float> referenceX(count), referenceY(count), accX(count), accY(count);
+
+    const double pairMs =
+        timeMs(seconds, [&] { pairLoop(scene, referenceX.data(), referenceY.data()); });
+    const double kernelMs = timeMs(seconds, [&] { kernel(scene, accX.data(), accY.data()); });
+
+    // the rsqrt refinement and the summation order differ from the pair loop
+    double worst = 0.0;
+    for (size_t i = 0; i < count; i++) {
+      const double reference = std::hypot(referenceX[i], referenceY[i]);
+      const double error     = std::hypot(accX[i] - referenceX[i], accY[i] - referenceY[i]);
+      worst                  = std::max(worst, error / std::max(reference, 1e-30));
+    }
+
+    std::printf("%8zu %14.3f %14.3f %16.3f %9.2fx %14.2e\n",
+                count,
+                pairMs,
+                kernelMs,
+                kernelMs * 1e6 / (double(count) * count),
+                pairMs / kernelMs,
+                worst);
+  }
+  return 0;
+}
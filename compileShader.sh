@@ -1,2 +1,10 @@
-/usr/bin/glslc /home/krizpe/Documents/vulkan-engine/src/shaders/simple.frag -o /home/krizpe/Documents/vulkan-engine/src/shaders/simple.frag.spv
-/usr/bin/glslc /home/krizpe/Documents/vulkan-engine/src/shaders/simple.vert -o /home/krizpe/Documents/vulkan-engine/src/shaders/simple.vert.spv
\ No newline at end of file
+#!/bin/bash
+# Compiles every shader in src/shaders to SPIR-V next to it, the same as the CMake build does.
+# Uses glslc from PATH, or $GLSLC.
+set -e
+SHADER_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)/src/shaders"
+GLSLC="${GLSLC:-glslc}"
+
+for shader in "$SHADER_DIR"/*.vert "$SHADER_DIR"/*.frag "$SHADER_DIR"/*.comp; do
+  "$GLSLC" "$shader" -o "$shader.spv"
+done
@@ -1,9 +1,10 @@
 #pragma once
 
 #include "EngineDevice.h"
-#include "GameObject.h"
 #include "Pipeline.h"
+#include "PipelineLibrary.h"
 #include "Renderer.h"
+#include "StagingRing.h"
 #include "Window.h"
 #include <memory>
 #include <string>
@@ -27,12 +28,10 @@ namespace kopi {
     void run();
 
   private:
-    void loadGameObjects();
-
     Window m_window{"kopi engine", WIDTH, HEIGHT};
     EngineDevice m_device{m_window};
+    StagingRing m_staging{m_device};
+    PipelineLibrary m_pipelines{m_device};
     Renderer m_renderer{m_window, m_device};
-
-    std::vector<GameObject> m_gameObjects;
   };
 } // namespace kopi
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Log.h"
+#include "World.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace kopi {
+  // std::vector allocator returning memory aligned for full width SIMD loads.
+  template <typename T, size_t Alignment = 64>
+  struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+      using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T *allocate(size_t n) {
+      return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+    }
+    void deallocate(T *p, size_t) { ::operator delete(p, std::align_val_t{Alignment}); }
+
+    friend bool operator==(const AlignedAllocator &, const AlignedAllocator &) { return true; }
+  };
+
+  using AlignedFloats = std::vector<float, AlignedAllocator<float>>;
+
+  // Structure-of-arrays body storage for the gravity solvers, so force kernels only stream the
+  // fields they need. Every array is padded up to a multiple of PADDING with massless bodies at the
+  // origin, which lets kernels run full SIMD lanes without a tail.
+  class BodyStore {
+  public:
+    static constexpr size_t PADDING = 8;
+
+    size_t size() const { return m_count; }
+    size_t paddedSize() const { return posX.size(); }
+
+    void resize(size_t count) {
+      accelerationsValid  = false;
+      m_count             = count;
+      const size_t padded = (count + PADDING - 1) / PADDING * PADDING;
+      for (auto *array : {&posX, &posY, &velX, &velY, &mass, &accX, &accY}) {
+        array->resize(padded);
+        std::fill(array->begin() + count, array->end(), 0.0f);
+      }
+    }
+
+    // every entity with a transform and a rigid body, in view order
+    void loadFrom(World &world) {
+      auto bodies = world.view<Transform2dComponent, RigidBody2dComponent>();
+      resize(bodies.size());
+      size_t i = 0;
+      for (auto chunk : bodies) {
+        auto transforms  = chunk.get<Transform2dComponent>();
+        auto rigidBodies = chunk.get<RigidBody2dComponent>();
+        for (size_t row = 0; row < chunk.size(); row++, i++) {
+          posX[i] = transforms[row].translation.x;
+          posY[i] = transforms[row].translation.y;
+          velX[i] = rigidBodies[row].velocity.x;
+          velY[i] = rigidBodies[row].velocity.y;
+          mass[i] = rigidBodies[row].mass;
+        }
+      }
+    }
+
+    void storeTo(World &world) const {
+      auto bodies = world.view<Transform2dComponent, RigidBody2dComponent>();
+      ASSERT_LOG(bodies.size() == m_count, "Body count changed since loadFrom!");
+      size_t i = 0;
+      for (auto chunk : bodies) {
+        auto transforms  = chunk.get<Transform2dComponent>();
+        auto rigidBodies = chunk.get<RigidBody2dComponent>();
+        for (size_t row = 0; row < chunk.size(); row++, i++) {
+          transforms[row].translation = {posX[i], posY[i]};
+          rigidBodies[row].velocity   = {velX[i], velY[i]};
+        }
+      }
+    }
+
+    AlignedFloats posX;
+    AlignedFloats posY;
+    AlignedFloats velX;
+    AlignedFloats velY;
+    AlignedFloats mass;
+    AlignedFloats accX;
+    AlignedFloats accY;
+    // Set by GravityPhysicsSystem when accX/accY hold the accelerations at the current positions,
+    // so its next update can skip the opening force pass. Whatever moves bodies or changes their
+    // mass from outside must clear it, resize and loadFrom do.
+    bool accelerationsValid = false;
+
+  private:
+    size_t m_count = 0;
+  };
+} // namespace kopi
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Model.h"
+#include <memory>
+
+namespace kopi {
+  struct Transform2dComponent {
+    glm::vec2 translation{}; // position offset
+    glm::vec2 scale{1.f, 1.f};
+    float rotation{0.0f};
+
+    // rotation * scale, kept up to date by TransformSystem. Set dirty after changing rotation or
+    // scale, translation is applied separately and needs no flag.
+    glm::mat2 matrix{1.0f};
+    bool dirty{true};
+  };
+
+  struct RigidBody2dComponent {
+     glm::vec2 velocity;
+     float mass{1.0f};
+   };
+
+  struct ColourComponent {
+    glm::vec3 colour{};
+  };
+
+  struct ModelComponent {
+    std::shared_ptr<Model> model{};
+  };
+
+  // marks a vector field arrow, the field at its position is shaded as the force on mass
+  struct FieldSampleComponent {
+    float mass{1.0f};
+  };
+} // namespace kopi
@@ -1,8 +1,11 @@
 #include "EngineDevice.h"
+#include "Hash.h"
 #include "Log.h"
 
 // std headers
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <set>
 #include <unordered_set>
 
@@ -44,17 +47,51 @@ namespace kopi {
     }
   }
 
+  // Precedes the driver's data in the pipeline cache file. The driver checks its own header as
+  // well, but not every driver rejects data from an older version of itself, so the driver
+  // version and a checksum are checked before the data ever reaches it.
+  struct PipelineCacheFileHeader {
+    static constexpr uint32_t MAGIC   = 0x4b504331; // "KPC1"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t dataHash;
+  };
+
   // class member functions
-  EngineDevice::EngineDevice(Window &window) : window{window} {
+  EngineDevice::EngineDevice(Window &window, std::string pipelineCachePath)
+      : EngineDevice(&window, std::move(pipelineCachePath)) {}
+
+  EngineDevice::EngineDevice(std::string pipelineCachePath)
+      : EngineDevice(nullptr, std::move(pipelineCachePath)) {}
+
+  EngineDevice::EngineDevice(Window *window, std::string pipelineCachePath)
+      : window{window}, pipelineCachePath_{std::move(pipelineCachePath)} {
     createInstance();
     setupDebugMessenger();
     createSurface();
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    createPipelineCache();
+    shaderModuleCache = std::make_unique<ShaderModuleCache>(device_);
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    memoryAllocator = std::make_unique<MemoryAllocator>(device_, memProperties);
   }
 
   EngineDevice::~EngineDevice() {
+    savePipelineCache();
+    vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+    shaderModuleCache.reset();
+    memoryAllocator.reset();
     vkDestroyCommandPool(device_, commandPool, nullptr);
     vkDestroyDevice(device_, nullptr);
 
@@ -62,7 +99,9 @@ namespace kopi {
       DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
     }
 
-    vkDestroySurfaceKHR(instance, surface_, nullptr);
+    if (surface_ != VK_NULL_HANDLE) {
+      vkDestroySurfaceKHR(instance, surface_, nullptr);
+    }
     vkDestroyInstance(instance, nullptr);
   }
 
@@ -78,7 +117,7 @@ namespace kopi {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName        = "No Engine";
     appInfo.engineVersion      = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion         = VK_API_VERSION_1_0;
+    appInfo.apiVersion         = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType                = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -141,7 +180,12 @@ namespace kopi {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+    graphicsFamily_ = indices.graphicsFamily;
+    transferFamily_ =
+        indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily,
+                                              indices.presentFamily,
+                                              transferFamily_};
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -156,15 +200,22 @@ namespace kopi {
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy        = VK_TRUE;
 
+    // uploads report completion through a timeline semaphore
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType              = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext              = &timelineFeatures;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos    = queueCreateInfos.data();
 
     createInfo.pEnabledFeatures        = &deviceFeatures;
-    createInfo.enabledExtensionCount   = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    auto extensions                    = getRequiredDeviceExtensions();
+    createInfo.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     // might not really be necessary anymore because device specific validation layers
     // have been deprecated
@@ -182,6 +233,7 @@ namespace kopi {
 
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+    vkGetDeviceQueue(device_, transferFamily_, 0, &transferQueue_);
   }
 
   void EngineDevice::createCommandPool() {
@@ -199,15 +251,124 @@ namespace kopi {
     }
   }
 
-  void EngineDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+  void EngineDevice::createPipelineCache() {
+    std::vector<char> file;
+    std::ifstream in(pipelineCachePath_, std::ios::binary | std::ios::ate);
+    if (in.is_open()) {
+      file.resize(static_cast<size_t>(in.tellg()));
+      in.seekg(0);
+      in.read(file.data(), static_cast<std::streamsize>(file.size()));
+      if (!in) {
+        file.clear();
+      }
+    }
+
+    // anything that does not match this exact device and driver is thrown away
+    const char *data = nullptr;
+    size_t dataSize  = 0;
+    PipelineCacheFileHeader header{};
+    if (file.size() >= sizeof(header)) {
+      memcpy(&header, file.data(), sizeof(header));
+      const char *payload = file.data() + sizeof(header);
+      if (header.magic == PipelineCacheFileHeader::MAGIC &&
+          header.version == PipelineCacheFileHeader::VERSION &&
+          header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+          header.driverVersion == properties.driverVersion &&
+          memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+          header.dataSize == file.size() - sizeof(header) &&
+          header.dataHash == hashBytes(payload, static_cast<size_t>(header.dataSize))) {
+        data     = payload;
+        dataSize = static_cast<size_t>(header.dataSize);
+      } else {
+        LOG_INFO("Pipeline cache {} is damaged or from another device or driver, ignoring it",
+                 pipelineCachePath_);
+      }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = dataSize;
+    cacheInfo.pInitialData    = data;
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+      // the driver may still refuse data that passed the checks above, start empty then
+      cacheInfo.initialDataSize = 0;
+      cacheInfo.pInitialData    = nullptr;
+      dataSize                  = 0;
+      if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+        LOG_ERROR("Failed to create pipeline cache!");
+        throw std::runtime_error("failed to create pipeline cache!");
+      }
+    }
+    pipelineCacheWarm_ = dataSize > 0;
+    if (pipelineCacheWarm_) {
+      LOG_INFO("Pipeline cache: warm, {} bytes from {}", dataSize, pipelineCachePath_);
+    } else {
+      LOG_INFO("Pipeline cache: cold");
+    }
+  }
+
+  void EngineDevice::savePipelineCache() {
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, nullptr) != VK_SUCCESS) {
+      LOG_WARN("Failed to read back the pipeline cache, not saving it");
+      return;
+    }
+    std::vector<char> file(sizeof(PipelineCacheFileHeader) + dataSize);
+    char *data = file.data() + sizeof(PipelineCacheFileHeader);
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, data) != VK_SUCCESS) {
+      LOG_WARN("Failed to read back the pipeline cache, not saving it");
+      return;
+    }
+    file.resize(sizeof(PipelineCacheFileHeader) + dataSize);
+
+    PipelineCacheFileHeader header{};
+    header.magic         = PipelineCacheFileHeader::MAGIC;
+    header.version       = PipelineCacheFileHeader::VERSION;
+    header.vendorID      = properties.vendorID;
+    header.deviceID      = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = dataSize;
+    header.dataHash = hashBytes(data, dataSize);
+    memcpy(file.data(), &header, sizeof(header));
+
+    // written next to the real file and renamed over it, which replaces it in one step
+    const std::string tempPath = pipelineCachePath_ + ".tmp";
+    {
+      std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+      out.write(file.data(), static_cast<std::streamsize>(file.size()));
+      out.flush();
+      if (!out) {
+        LOG_WARN("Failed to write pipeline cache {}", tempPath);
+        std::error_code ignored;
+        std::filesystem::remove(tempPath, ignored);
+        return;
+      }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, pipelineCachePath_, error);
+    if (error) {
+      LOG_WARN("Failed to replace pipeline cache {}: {}", pipelineCachePath_, error.message());
+      std::filesystem::remove(tempPath, error);
+      return;
+    }
+    LOG_DEBUG("Saved {} bytes of pipeline cache to {}", dataSize, pipelineCachePath_);
+  }
+
+  void EngineDevice::createSurface() {
+    if (window != nullptr) {
+      window->createWindowSurface(instance, &surface_);
+    }
+  }
 
   bool EngineDevice::isDeviceSuitable(VkPhysicalDevice device) {
     QueueFamilyIndices indices = findQueueFamilies(device);
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    // headless there is nothing to present to
+    bool swapChainAdequate = window == nullptr;
+    if (extensionsSupported && window != nullptr) {
       SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
       swapChainAdequate =
           !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -216,8 +377,19 @@ namespace kopi {
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &timelineFeatures;
+    if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+      vkGetPhysicalDeviceFeatures2(device, &features2);
+    }
+
     return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-           supportedFeatures.samplerAnisotropy;
+           supportedFeatures.samplerAnisotropy && timelineFeatures.timelineSemaphore;
   }
 
   void
@@ -272,11 +444,13 @@ namespace kopi {
   }
 
   std::vector<const char *> EngineDevice::getRequiredExtensions() {
-    uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char *> extensions;
+    if (window != nullptr) {
+      uint32_t glfwExtensionCount = 0;
+      const char **glfwExtensions;
+      glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+      extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableValidationLayers) {
       extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -285,6 +459,13 @@ namespace kopi {
     return extensions;
   }
 
+  std::vector<const char *> EngineDevice::getRequiredDeviceExtensions() {
+    if (window == nullptr) {
+      return {};
+    }
+    return deviceExtensions;
+  }
+
   void EngineDevice::hasGflwRequiredInstanceExtensions() {
     uint32_t extensionCount = 0;
     vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
@@ -323,7 +504,8 @@ namespace kopi {
                                          &extensionCount,
                                          availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    auto required = getRequiredDeviceExtensions();
+    std::set<std::string> requiredExtensions(required.begin(), required.end());
 
     for (const auto &extension : availableExtensions) {
       requiredExtensions.erase(extension.extensionName);
@@ -343,23 +525,41 @@ namespace kopi {
 
     int i = 0;
     for (const auto &queueFamily : queueFamilies) {
-      if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      // the graphics queue also records compute dispatches, so it needs both
+      const VkQueueFlags graphicsCompute = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+      if (queueFamily.queueCount > 0 && !indices.graphicsFamilyHasValue &&
+          (queueFamily.queueFlags & graphicsCompute) == graphicsCompute) {
         indices.graphicsFamily         = i;
         indices.graphicsFamilyHasValue = true;
       }
       VkBool32 presentSupport = false;
-      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-      if (queueFamily.queueCount > 0 && presentSupport) {
+      if (surface_ != VK_NULL_HANDLE) {
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+      }
+      if (queueFamily.queueCount > 0 && !indices.presentFamilyHasValue && presentSupport) {
         indices.presentFamily         = i;
         indices.presentFamilyHasValue = true;
       }
-      if (indices.isComplete()) {
-        break;
+      // transfer only families are preferred over async compute ones, they are the copy engines
+      const bool transferOnly = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                                !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+      const bool replacesCompute =
+          !indices.transferFamilyHasValue ||
+          ((queueFamilies[indices.transferFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+           !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT));
+      if (queueFamily.queueCount > 0 && transferOnly && replacesCompute) {
+        indices.transferFamily         = i;
+        indices.transferFamilyHasValue = true;
       }
 
       i++;
     }
 
+    // headless nothing is presented, the graphics family stands in so queue setup is unchanged
+    if (window == nullptr && indices.graphicsFamilyHasValue) {
+      indices.presentFamily         = indices.graphicsFamily;
+      indices.presentFamilyHasValue = true;
+    }
     return indices;
   }
 
@@ -424,13 +624,20 @@ namespace kopi {
                                   VkBufferUsageFlags usage,
                                   VkMemoryPropertyFlags properties,
                                   VkBuffer &buffer,
-                                  VkDeviceMemory &bufferMemory) {
+                                  MemoryAllocation &bufferMemory) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size        = size;
     bufferInfo.usage       = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    const uint32_t families[] = {graphicsFamily_, transferFamily_};
+    if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && hasDedicatedTransferQueue()) {
+      bufferInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+      bufferInfo.queueFamilyIndexCount = 2;
+      bufferInfo.pQueueFamilyIndices   = families;
+    }
+
     if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
       LOG_ERROR("Failed to create vertex buffer!");
       throw std::runtime_error("failed to create vertex buffer!");
@@ -439,96 +646,23 @@ namespace kopi {
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize  = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-      LOG_ERROR("Failed to allocate vertex buffer memory!");
-      throw std::runtime_error("failed to allocate vertex buffer memory!");
-    }
-
-    vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+    bufferMemory = memoryAllocator->allocate(memRequirements,
+                                             findMemoryType(memRequirements.memoryTypeBits,
+                                                            properties),
+                                             false);
+    vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset);
   }
 
-  VkCommandBuffer EngineDevice::beginSingleTimeCommands() {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool        = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    return commandBuffer;
-  }
-
-  void EngineDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers    = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue_);
-
-    vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
-  }
-
-  void EngineDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0; // Optional
-    copyRegion.dstOffset = 0; // Optional
-    copyRegion.size      = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
-  }
-
-  void EngineDevice::copyBufferToImage(VkBuffer buffer,
-                                       VkImage image,
-                                       uint32_t width,
-                                       uint32_t height,
-                                       uint32_t layerCount) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkBufferImageCopy region{};
-    region.bufferOffset      = 0;
-    region.bufferRowLength   = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel       = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount     = layerCount;
-
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-
-    vkCmdCopyBufferToImage(commandBuffer,
-                           buffer,
-                           image,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1,
-                           &region);
-    endSingleTimeCommands(commandBuffer);
+  void EngineDevice::destroyBuffer(VkBuffer &buffer, MemoryAllocation &bufferMemory) {
+    vkDestroyBuffer(device_, buffer, nullptr);
+    memoryAllocator->free(bufferMemory);
+    buffer = VK_NULL_HANDLE;
   }
 
   void EngineDevice::createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                          VkMemoryPropertyFlags properties,
                                          VkImage &image,
-                                         VkDeviceMemory &imageMemory) {
+                                         MemoryAllocation &imageMemory) {
     if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
       LOG_ERROR("Failed to create image!");
       throw std::runtime_error("failed to create image!");
@@ -537,20 +671,22 @@ namespace kopi {
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize  = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+    // linearly tiled images follow the same rules as buffers, so only optimal ones are kept apart
+    imageMemory = memoryAllocator->allocate(memRequirements,
+                                            findMemoryType(memRequirements.memoryTypeBits,
+                                                           properties),
+                                            imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL);
 
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-      LOG_ERROR("Failed to allocate image memory!");
-      throw std::runtime_error("failed to allocate image memory!");
-    }
-
-    if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+    if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
       LOG_ERROR("Failed to bind image memory!");
       throw std::runtime_error("failed to bind image memory!");
     }
   }
 
+  void EngineDevice::destroyImage(VkImage &image, MemoryAllocation &imageMemory) {
+    vkDestroyImage(device_, image, nullptr);
+    memoryAllocator->free(imageMemory);
+    image = VK_NULL_HANDLE;
+  }
+
 } // namespace kopi
\ No newline at end of file
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "MemoryAllocator.h"
+#include "ShaderModuleCache.h"
 #include "Window.h"
 
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace kopi {
@@ -15,11 +19,21 @@ namespace kopi {
   struct QueueFamilyIndices {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    // a family that can copy but not draw, usually backed by a DMA engine
+    uint32_t transferFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue  = false;
+    bool transferFamilyHasValue = false;
     bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
   };
 
+  // A submission waits until semaphore, a timeline semaphore, reaches value before stages run.
+  struct TimelineWait {
+    VkSemaphore semaphore       = VK_NULL_HANDLE;
+    uint64_t value              = 0;
+    VkPipelineStageFlags stages = 0;
+  };
+
   class EngineDevice {
   public:
 #ifdef NDEBUG
@@ -28,7 +42,13 @@ namespace kopi {
     const bool enableValidationLayers = true;
 #endif
 
-    EngineDevice(Window &window);
+    static constexpr const char *DEFAULT_PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
+    // The pipeline cache is loaded from pipelineCachePath and written back to it on destruction.
+    EngineDevice(Window &window, std::string pipelineCachePath = DEFAULT_PIPELINE_CACHE_PATH);
+    // Headless, for compute and tests: no surface and no swap chain, so any device with a graphics
+    // and compute queue will do, software ones such as lavapipe included.
+    explicit EngineDevice(std::string pipelineCachePath);
     ~EngineDevice();
 
     // Not copyable or movable
@@ -42,6 +62,16 @@ namespace kopi {
     VkSurfaceKHR surface() { return surface_; }
     VkQueue graphicsQueue() { return graphicsQueue_; }
     VkQueue presentQueue() { return presentQueue_; }
+    // The dedicated transfer queue when the device has one, the graphics queue otherwise.
+    VkQueue transferQueue() { return transferQueue_; }
+    uint32_t transferFamily() { return transferFamily_; }
+    bool hasDedicatedTransferQueue() { return transferFamily_ != graphicsFamily_; }
+    // Pass to every pipeline creation, it starts out with what earlier runs compiled.
+    VkPipelineCache pipelineCache() { return pipelineCache_; }
+    // true when the cache was loaded from an earlier run instead of starting empty
+    bool pipelineCacheWarm() const { return pipelineCacheWarm_; }
+    // Every pipeline gets its shader modules from here, one per distinct SPIR-V.
+    ShaderModuleCache &shaderModules() { return *shaderModuleCache; }
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -51,38 +81,46 @@ namespace kopi {
                                  VkFormatFeatureFlags features);
 
     // Buffer Helper Functions
+    // Memory is sub-allocated from shared blocks, so it must be released with destroyBuffer and
+    // never with vkFreeMemory. Host visible memory comes back already mapped. Transfer
+    // destinations are shared between the graphics and transfer families, so data copied on the
+    // transfer queue needs no ownership transfer before it is used. Data gets there through a
+    // StagingRing, nothing on the device blocks on a queue.
     void createBuffer(VkDeviceSize size,
                       VkBufferUsageFlags usage,
                       VkMemoryPropertyFlags properties,
                       VkBuffer &buffer,
-                      VkDeviceMemory &bufferMemory);
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-    void copyBufferToImage(VkBuffer buffer,
-                           VkImage image,
-                           uint32_t width,
-                           uint32_t height,
-                           uint32_t layerCount);
+                      MemoryAllocation &bufferMemory);
+    void destroyBuffer(VkBuffer &buffer, MemoryAllocation &bufferMemory);
 
     void createImageWithInfo(const VkImageCreateInfo &imageInfo,
                              VkMemoryPropertyFlags properties,
                              VkImage &image,
-                             VkDeviceMemory &imageMemory);
+                             MemoryAllocation &imageMemory);
+    void destroyImage(VkImage &image, MemoryAllocation &imageMemory);
+
+    MemoryStats memoryStats() const { return memoryAllocator->stats(); }
 
     VkPhysicalDeviceProperties properties;
 
   private:
+    EngineDevice(Window *window, std::string pipelineCachePath);
+
     void createInstance();
     void setupDebugMessenger();
     void createSurface();
     void pickPhysicalDevice();
     void createLogicalDevice();
     void createCommandPool();
+    void createPipelineCache();
+    // Writes the pipeline cache to pipelineCachePath_, replacing the old file only once the new
+    // one is complete so a crash mid write never leaves a torn cache behind.
+    void savePipelineCache();
 
     // helper functions
     bool isDeviceSuitable(VkPhysicalDevice device);
     std::vector<const char *> getRequiredExtensions();
+    std::vector<const char *> getRequiredDeviceExtensions();
     bool checkValidationLayerSupport();
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
@@ -93,13 +131,21 @@ namespace kopi {
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-    Window &window;
+    Window *window; // null when headless
     VkCommandPool commandPool;
 
     VkDevice device_;
-    VkSurfaceKHR surface_;
+    VkSurfaceKHR surface_ = VK_NULL_HANDLE;
     VkQueue graphicsQueue_;
     VkQueue presentQueue_;
+    VkQueue transferQueue_;
+    uint32_t graphicsFamily_;
+    uint32_t transferFamily_;
+    std::unique_ptr<MemoryAllocator> memoryAllocator;
+    VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+    bool pipelineCacheWarm_        = false;
+    std::unique_ptr<ShaderModuleCache> shaderModuleCache;
+    std::string pipelineCachePath_;
 
     const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
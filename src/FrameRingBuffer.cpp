@@ -0,0 +1,70 @@
+#include "FrameRingBuffer.h"
+#include "Log.h"
+
+namespace kopi {
+  FrameRingBuffer::FrameRingBuffer(EngineDevice &device,
+                                   uint32_t frameCount,
+                                   VkDeviceSize frameSize)
+      : m_device(device), m_frameCount(frameCount), m_frameSize(frameSize) {
+    ASSERT_LOG(m_frameCount > 0, "A frame ring buffer needs at least one frame");
+    createBuffer(m_frameSize);
+  }
+
+  FrameRingBuffer::~FrameRingBuffer() {
+    for (auto &retired : m_retired) {
+      m_device.destroyBuffer(retired.buffer, retired.memory);
+    }
+    m_device.destroyBuffer(m_buffer, m_memory);
+  }
+
+  void FrameRingBuffer::beginFrame(uint32_t frameIndex) {
+    ASSERT_LOG(frameIndex < m_frameCount, "Frame index {} is out of range!", frameIndex);
+    m_frameIndex = frameIndex;
+    m_frameStart = m_frameSize * frameIndex;
+    m_head       = m_frameStart;
+
+    // a replaced buffer is free once every frame has begun again after it was replaced
+    for (size_t i = 0; i < m_retired.size();) {
+      if (--m_retired[i].framesLeft == 0) {
+        m_device.destroyBuffer(m_retired[i].buffer, m_retired[i].memory);
+        m_retired[i] = m_retired.back();
+        m_retired.pop_back();
+      } else {
+        i++;
+      }
+    }
+  }
+
+  FrameAllocation FrameRingBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    ASSERT_LOG((alignment & (alignment - 1)) == 0, "Alignment {} is not a power of two", alignment);
+    VkDeviceSize offset = (m_head + alignment - 1) & ~(alignment - 1);
+    if (offset + size > m_frameStart + m_frameSize) {
+      // draws recorded earlier this frame still read the old buffer, so it is only retired
+      m_retired.push_back({m_buffer, m_memory, m_frameCount});
+      VkDeviceSize frameSize = 2 * m_frameSize;
+      while (frameSize < size + alignment) {
+        frameSize *= 2;
+      }
+      createBuffer(frameSize);
+      m_frameStart = m_frameSize * m_frameIndex;
+      offset       = (m_frameStart + alignment - 1) & ~(alignment - 1);
+    }
+    m_head = offset + size;
+
+    FrameAllocation allocation{};
+    allocation.buffer = m_buffer;
+    allocation.offset = offset;
+    allocation.mapped = static_cast<char *>(m_memory.mapped) + offset;
+    return allocation;
+  }
+
+  void FrameRingBuffer::createBuffer(VkDeviceSize frameSize) {
+    m_frameSize = frameSize;
+    m_device.createBuffer(m_frameSize * m_frameCount,
+                          USAGE,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          m_buffer,
+                          m_memory);
+  }
+} // namespace kopi
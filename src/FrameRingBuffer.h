@@ -0,0 +1,77 @@
+#pragma once
+
+#include "EngineDevice.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace kopi {
+  // A sub-range of the current frame's part of a FrameRingBuffer, valid until that frame comes
+  // round again.
+  struct FrameAllocation {
+    VkBuffer buffer     = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    void *mapped        = nullptr;
+  };
+
+  // Streams data the CPU writes every frame, instance data, uniforms and the like. One
+  // persistently mapped, host coherent buffer is split into one region per frame in flight and
+  // allocate bumps through the current frame's region, so writing thousands of records is a
+  // memcpy with no mapping, allocation or synchronisation. beginFrame starts a region over once
+  // the frame's fence has signalled, the GPU is done with everything in it by then.
+  //
+  // When a frame outgrows its region the whole buffer is replaced by one twice the size, the old
+  // one lives on until every frame that may still read it has come round. Not thread safe.
+  class FrameRingBuffer {
+  public:
+    static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 1ull << 20;
+    static constexpr VkBufferUsageFlags USAGE =
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    FrameRingBuffer(EngineDevice &device,
+                    uint32_t frameCount,
+                    VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+    ~FrameRingBuffer();
+
+    FrameRingBuffer(const FrameRingBuffer &)            = delete;
+    FrameRingBuffer &operator=(const FrameRingBuffer &) = delete;
+
+    // Must only be called once the previous use of frameIndex has finished on the GPU.
+    void beginFrame(uint32_t frameIndex);
+
+    // size bytes at a multiple of alignment, a power of two. Bound as a uniform or storage buffer
+    // the alignment has to cover the device's minimum offset alignment for that use.
+    FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+    template <typename T> T *allocate(size_t count, FrameAllocation &allocation) {
+      allocation = allocate(sizeof(T) * count, alignof(T) < 16 ? 16 : alignof(T));
+      return static_cast<T *>(allocation.mapped);
+    }
+
+    VkDeviceSize frameSize() const { return m_frameSize; }
+    // bytes handed out since beginFrame
+    VkDeviceSize frameUsed() const { return m_head - m_frameStart; }
+
+  private:
+    struct RetiredBuffer {
+      VkBuffer buffer;
+      MemoryAllocation memory;
+      uint32_t framesLeft;
+    };
+
+    void createBuffer(VkDeviceSize frameSize);
+
+    EngineDevice &m_device;
+    uint32_t m_frameCount;
+    VkDeviceSize m_frameSize;
+    VkBuffer m_buffer         = VK_NULL_HANDLE;
+    MemoryAllocation m_memory = {};
+
+    uint32_t m_frameIndex     = 0;
+    VkDeviceSize m_frameStart = 0; // offset of the current frame's region
+    VkDeviceSize m_head       = 0;
+    std::vector<RetiredBuffer> m_retired;
+  };
+} // namespace kopi
@@ -0,0 +1,291 @@
+#include "GpuNBodySystem.h"
+#include "Log.h"
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace kopi {
+  struct NBodyComputePushConstantData {
+    uint32_t bodyCount;
+    float dt;
+    float strength;
+    float softening;
+  };
+
+  struct NBodyRenderPushConstantData {
+    glm::mat2 transform{1.0f};
+  };
+
+  static uint32_t packColour(glm::vec3 colour) {
+    auto channel = [](float value) {
+      return static_cast<uint32_t>(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    };
+    return channel(colour.r) | channel(colour.g) << 8 | channel(colour.b) << 16 | 0xffu << 24;
+  }
+
+  static VkBufferMemoryBarrier bodyBufferBarrier(VkBuffer buffer,
+                                                 VkAccessFlags srcAccessMask,
+                                                 VkAccessFlags dstAccessMask) {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask       = srcAccessMask;
+    barrier.dstAccessMask       = dstAccessMask;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer              = buffer;
+    barrier.offset              = 0;
+    barrier.size                = VK_WHOLE_SIZE;
+    return barrier;
+  }
+
+  GpuNBodySystem::GpuNBodySystem(EngineDevice &device,
+                                 StagingRing &staging,
+                                 PipelineLibrary &pipelines,
+                                 VkRenderPass renderPass,
+                                 World &world,
+                                 float strength)
+      : strengthGravity{strength}, m_device{device} {
+    createBodyBuffers(staging, world);
+    createDescriptorSets(pipelines);
+    createPipelineLayouts(pipelines);
+    createPipelines(pipelines, renderPass);
+  }
+
+  GpuNBodySystem::~GpuNBodySystem() {
+    vkDestroyDescriptorPool(m_device.device(), m_descriptorPool, nullptr);
+    for (size_t i = 0; i < m_bodyBuffers.size(); i++) {
+      m_device.destroyBuffer(m_bodyBuffers[i], m_bodyBufferMemory[i]);
+    }
+  }
+
+  void GpuNBodySystem::dispatch(VkCommandBuffer commandBuffer, float dt) {
+    if (!m_computePipeline.ready()) {
+      return;
+    }
+    const uint32_t next = 1 - m_current;
+
+    // write after read: earlier draws and dispatches may still be reading the buffer about to be
+    // overwritten, an execution dependency is enough to order them
+    VkBufferMemoryBarrier beforeWrite = bodyBufferBarrier(m_bodyBuffers[next],
+                                                          0,
+                                                          VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         1,
+                         &beforeWrite,
+                         0,
+                         nullptr);
+
+    m_computePipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_computePipelineLayout,
+                            0,
+                            1,
+                            &m_descriptorSets[m_current],
+                            0,
+                            nullptr);
+
+    NBodyComputePushConstantData push{};
+    push.bodyCount = m_bodyCount;
+    push.dt        = dt;
+    push.strength  = strengthGravity;
+    push.softening = softening;
+    vkCmdPushConstants(commandBuffer,
+                       m_computePipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(NBodyComputePushConstantData),
+                       &push);
+    vkCmdDispatch(commandBuffer, (m_bodyCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    // read after write: the new state feeds this frame's draw and the next dispatch
+    VkBufferMemoryBarrier afterWrite =
+        bodyBufferBarrier(m_bodyBuffers[next],
+                          VK_ACCESS_SHADER_WRITE_BIT,
+                          VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         1,
+                         &afterWrite,
+                         0,
+                         nullptr);
+
+    m_current = next;
+  }
+
+  void GpuNBodySystem::render(VkCommandBuffer commandBuffer, Model &model, float scale) {
+    if (!m_renderPipeline.ready()) {
+      return;
+    }
+    m_renderPipeline->bind(commandBuffer);
+
+    NBodyRenderPushConstantData push{};
+    push.transform = glm::mat2{scale};
+    vkCmdPushConstants(commandBuffer,
+                       m_renderPipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT,
+                       0,
+                       sizeof(NBodyRenderPushConstantData),
+                       &push);
+
+    model.bind(commandBuffer);
+    VkBuffer instanceBuffers[] = {m_bodyBuffers[m_current]};
+    VkDeviceSize offsets[]     = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 1, 1, instanceBuffers, offsets);
+    model.draw(commandBuffer, m_bodyCount);
+  }
+
+  void GpuNBodySystem::createBodyBuffers(StagingRing &staging, World &world) {
+    std::vector<Body> bodies;
+    for (auto chunk : world.view<Transform2dComponent, RigidBody2dComponent, ColourComponent>()) {
+      auto transforms  = chunk.get<Transform2dComponent>();
+      auto rigidBodies = chunk.get<RigidBody2dComponent>();
+      auto colours     = chunk.get<ColourComponent>();
+      for (size_t row = 0; row < chunk.size(); row++) {
+        Body &body    = bodies.emplace_back();
+        body.position = transforms[row].translation;
+        body.velocity = rigidBodies[row].velocity;
+        body.mass     = rigidBodies[row].mass;
+        body.colour   = packColour(colours[row].colour);
+      }
+    }
+    m_bodyCount = static_cast<uint32_t>(bodies.size());
+    ASSERT_LOG(m_bodyCount > 0, "GPU N-body needs at least one body");
+    VkDeviceSize bufferSize = sizeof(Body) * m_bodyCount;
+
+    for (size_t i = 0; i < m_bodyBuffers.size(); i++) {
+      m_device.createBuffer(bufferSize,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                            m_bodyBuffers[i],
+                            m_bodyBufferMemory[i]);
+    }
+    staging.upload(m_bodyBuffers[m_current],
+                   0,
+                   bodies.data(),
+                   bufferSize,
+                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  }
+
+  void GpuNBodySystem::createDescriptorSets(PipelineLibrary &pipelines) {
+    std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+    for (uint32_t i = 0; i < 2; i++) {
+      bindings[i].binding         = i;
+      bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      bindings[i].descriptorCount = 1;
+      bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    m_descriptorSetLayout = pipelines.descriptorSetLayout(bindings);
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 4;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets       = 2;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes    = &poolSize;
+
+    if (vkCreateDescriptorPool(m_device.device(), &poolInfo, nullptr, &m_descriptorPool) !=
+        VK_SUCCESS) {
+      LOG_ERROR("Failed to create descriptor pool!");
+      throw std::runtime_error("Failed to create descriptor pool!");
+    }
+
+    VkDescriptorSetLayout setLayouts[] = {m_descriptorSetLayout, m_descriptorSetLayout};
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool     = m_descriptorPool;
+    allocInfo.descriptorSetCount = 2;
+    allocInfo.pSetLayouts        = setLayouts;
+
+    if (vkAllocateDescriptorSets(m_device.device(), &allocInfo, m_descriptorSets.data()) !=
+        VK_SUCCESS) {
+      LOG_ERROR("Failed to allocate descriptor sets!");
+      throw std::runtime_error("Failed to allocate descriptor sets!");
+    }
+
+    for (uint32_t set = 0; set < 2; set++) {
+      VkDescriptorBufferInfo bufferInfos[2]{};
+      bufferInfos[0].buffer = m_bodyBuffers[set];
+      bufferInfos[0].range  = VK_WHOLE_SIZE;
+      bufferInfos[1].buffer = m_bodyBuffers[1 - set];
+      bufferInfos[1].range  = VK_WHOLE_SIZE;
+
+      VkWriteDescriptorSet write{};
+      write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet          = m_descriptorSets[set];
+      write.dstBinding      = 0;
+      write.descriptorCount = 2;
+      write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      write.pBufferInfo     = bufferInfos;
+      vkUpdateDescriptorSets(m_device.device(), 1, &write, 0, nullptr);
+    }
+  }
+
+  void GpuNBodySystem::createPipelineLayouts(PipelineLibrary &pipelines) {
+    VkPushConstantRange computePushRange{};
+    computePushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    computePushRange.offset     = 0;
+    computePushRange.size       = sizeof(NBodyComputePushConstantData);
+
+    m_computePipelineLayout = pipelines.pipelineLayout({m_descriptorSetLayout}, {computePushRange});
+
+    VkPushConstantRange renderPushRange{};
+    renderPushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    renderPushRange.offset     = 0;
+    renderPushRange.size       = sizeof(NBodyRenderPushConstantData);
+
+    m_renderPipelineLayout = pipelines.pipelineLayout({}, {renderPushRange});
+  }
+
+  void GpuNBodySystem::createPipelines(PipelineLibrary &pipelines, VkRenderPass renderPass) {
+    // the shader needs the workgroup and the shared tile the same size
+    m_computePipeline = pipelines.compute("src/shaders/nbody.comp.spv",
+                                          m_computePipelineLayout,
+                                          SpecializationConstants{}
+                                              .set(WORKGROUP_SIZE_CONSTANT, WORKGROUP_SIZE)
+                                              .set(TILE_SIZE_CONSTANT, WORKGROUP_SIZE));
+    if (renderPass == VK_NULL_HANDLE) {
+      return;
+    }
+
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+
+    pipelineConfig.renderPass     = renderPass;
+    pipelineConfig.pipelineLayout = m_renderPipelineLayout;
+
+    // binding 0 is the model's vertices, binding 1 steps once per body through the storage buffer
+    pipelineConfig.bindingDescriptions.resize(2);
+    pipelineConfig.bindingDescriptions[1].binding   = 1;
+    pipelineConfig.bindingDescriptions[1].stride    = sizeof(Body);
+    pipelineConfig.bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    pipelineConfig.attributeDescriptions.resize(4);
+    pipelineConfig.attributeDescriptions[2].binding  = 1;
+    pipelineConfig.attributeDescriptions[2].location = 2;
+    pipelineConfig.attributeDescriptions[2].format   = VK_FORMAT_R32G32_SFLOAT;
+    pipelineConfig.attributeDescriptions[2].offset   = offsetof(Body, position);
+
+    pipelineConfig.attributeDescriptions[3].binding  = 1;
+    pipelineConfig.attributeDescriptions[3].location = 3;
+    pipelineConfig.attributeDescriptions[3].format   = VK_FORMAT_R8G8B8A8_UNORM;
+    pipelineConfig.attributeDescriptions[3].offset   = offsetof(Body, colour);
+
+    m_renderPipeline = pipelines.graphics("src/shaders/nbody.vert.spv",
+                                          "src/shaders/nbody.frag.spv",
+                                          pipelineConfig);
+  }
+} // namespace kopi
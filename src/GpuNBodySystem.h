@@ -0,0 +1,94 @@
+#pragma once
+
+#include "EngineDevice.h"
+#include "World.h"
+#include "Model.h"
+#include "Pipeline.h"
+#include "PipelineLibrary.h"
+#include "StagingRing.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace kopi {
+  // Direct-sum N-body integrated on the GPU. Bodies live in two device local storage buffers that
+  // nbody.comp ping-pongs between, tiling sources through shared memory, and the newest buffer is
+  // bound straight as an instance vertex buffer for drawing, so positions never round-trip through
+  // the CPU. Only core Vulkan 1.0 compute is used, so software ICDs such as lavapipe run it too.
+  class GpuNBodySystem {
+  public:
+    // std430 layout shared with nbody.comp and the instance inputs of nbody.vert
+    struct Body {
+      glm::vec2 position;
+      glm::vec2 velocity;
+      float mass;
+      uint32_t colour; // RGBA8
+    };
+    static_assert(sizeof(Body) == 24, "Body must match the std430 layout in nbody.comp");
+
+    // nbody.comp's workgroup and shared tile size, passed in as specialization constants
+    static constexpr uint32_t WORKGROUP_SIZE = 128;
+    // the constant_ids nbody.comp declares them under, local_size_x_id and TILE_SIZE's
+    static constexpr uint32_t WORKGROUP_SIZE_CONSTANT = 0;
+    static constexpr uint32_t TILE_SIZE_CONSTANT      = 1;
+
+    // The initial bodies go up through staging, the first dispatch must wait for them. dispatch
+    // and render record nothing until their pipeline from pipelines has compiled. With a null
+    // renderPass there is no render pipeline and render draws nothing, for headless use.
+    GpuNBodySystem(EngineDevice &device,
+                   StagingRing &staging,
+                   PipelineLibrary &pipelines,
+                   VkRenderPass renderPass,
+                   World &world,
+                   float strength);
+    ~GpuNBodySystem();
+
+    GpuNBodySystem(const GpuNBodySystem &)            = delete;
+    GpuNBodySystem &operator=(const GpuNBodySystem &) = delete;
+
+    const float strengthGravity;
+    // Plummer softening length, keeps close encounters finite without a per-pair branch
+    float softening = 0.01f;
+
+    // Records one semi-implicit Euler step. Must be recorded outside a render pass.
+    void dispatch(VkCommandBuffer commandBuffer, float dt);
+    // Draws every body as an instance of model, scaled by scale. Recorded inside a render pass.
+    void render(VkCommandBuffer commandBuffer, Model &model, float scale);
+
+    uint32_t bodyCount() const { return m_bodyCount; }
+    // dispatch records work, the compute pipeline has compiled
+    bool ready() const { return m_computePipeline.ready(); }
+    // Holds the newest state as bodyCount() Bodies, read it after the last dispatch's barrier.
+    VkBuffer bodyBuffer() const { return m_bodyBuffers[m_current]; }
+
+  private:
+    void createBodyBuffers(StagingRing &staging, World &world);
+    void createDescriptorSets(PipelineLibrary &pipelines);
+    void createPipelineLayouts(PipelineLibrary &pipelines);
+    void createPipelines(PipelineLibrary &pipelines, VkRenderPass renderPass);
+
+    EngineDevice &m_device;
+    uint32_t m_bodyCount = 0;
+
+    std::array<VkBuffer, 2> m_bodyBuffers{};
+    std::array<MemoryAllocation, 2> m_bodyBufferMemory{};
+    uint32_t m_current = 0; // buffer holding the newest state
+
+    // owned by the pipeline library, like both pipeline layouts
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool           = VK_NULL_HANDLE;
+    // set i reads buffer i and writes the other one
+    std::array<VkDescriptorSet, 2> m_descriptorSets{};
+
+    VkPipelineLayout m_computePipelineLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_renderPipelineLayout  = VK_NULL_HANDLE;
+    PipelineHandle m_computePipeline;
+    PipelineHandle m_renderPipeline;
+  };
+} // namespace kopi
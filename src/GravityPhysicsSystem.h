@@ -0,0 +1,415 @@
+#pragma once
+
+#include "BodyStore.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "NBodyKernel.h"
+#include "ParticleMesh.h"
+#include "QuadTree.h"
+#include "World.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace kopi {
+  enum class GravitySolver {
+    DirectSum,   // exact O(N^2) pairwise sum
+    BarnesHut,   // O(N log N) quadtree approximation, see QuadTree
+    ParticleMesh // O(N + M log M) FFT grid solver for very large counts, see ParticleMesh
+  };
+
+  enum class Integrator {
+    SemiImplicitEuler, // 1st order, 1 force pass per substep
+    Leapfrog,          // kick-drift-kick velocity Verlet, 2nd order, 1 force pass per substep
+    Yoshida4           // Forest-Ruth / Yoshida 4th order, 3 force passes per substep
+  };
+
+  class GravityPhysicsSystem {
+  public:
+    GravityPhysicsSystem(float strength) : strengthGravity{strength} {}
+
+    const float strengthGravity;
+
+    GravitySolver solver  = GravitySolver::DirectSum;
+    Integrator integrator = Integrator::SemiImplicitEuler;
+    // Barnes-Hut opening angle, smaller is more accurate and slower
+    float theta = 0.5f;
+    // particle-mesh grid nodes per side (power of two) and Plummer softening length
+    uint32_t meshResolution = 256;
+    float meshSoftening     = 0.01f;
+    // optional, the force pass runs on the calling thread when null
+    JobSystem *jobSystem = nullptr;
+    // Block timesteps. Each body steps with (dt / substeps) / 2^rung, its rung picked from its own
+    // acceleration as sqrt(2 * eta * length / |a|), and only bodies at the end of their step get
+    // forces recomputed. Bodies integrate with kick-drift-kick leapfrog, integrator is ignored.
+    bool adaptiveTimesteps = false;
+    uint32_t maxRung       = 8;
+    float timestepEta      = 0.025f;
+    float timestepLength   = 0.01f;
+
+    void update(World &world, float dt, unsigned int substeps = 1) {
+      m_bodies.loadFrom(world);
+      update(m_bodies, dt, substeps);
+      m_bodies.storeTo(world);
+    }
+
+    void update(BodyStore &bodies, float dt, unsigned int substeps = 1) {
+      const float stepDelta = dt / substeps;
+      // cleared up front, so a pass that throws halfway never leaves stale forces marked valid
+      const bool reuseAccelerations =
+          bodies.accelerationsValid && m_forceSettings == forceSettings();
+      bodies.accelerationsValid = false;
+
+      if (adaptiveTimesteps) {
+        ASSERT_LOG(maxRung <= MAX_RUNG, "maxRung must be at most {}, got {}", MAX_RUNG, maxRung);
+        // stepBlocks leaves every body with forces for its final position, like leapfrog
+        if (!reuseAccelerations) {
+          computeAccelerations(bodies);
+        }
+        m_rungs.resize(bodies.size());
+        for (size_t i = 0; i < bodies.size(); i++) {
+          m_rungs[i] = rungFor(bodies.accX[i], bodies.accY[i], stepDelta);
+        }
+        for (unsigned int i = 0; i < substeps; i++) {
+          stepBlocks(bodies, stepDelta);
+        }
+        bodies.accelerationsValid = true;
+        return;
+      }
+
+      switch (integrator) {
+        case Integrator::SemiImplicitEuler:
+          for (unsigned int i = 0; i < substeps; i++) {
+            computeAccelerations(bodies);
+            kick(bodies, stepDelta);
+            drift(bodies, stepDelta);
+          }
+          break;
+
+        case Integrator::Leapfrog:
+          // The closing kick's forces open the next substep and stay in the store for the next
+          // update, so a store stepped only through here costs one force pass per substep.
+          if (!reuseAccelerations) {
+            computeAccelerations(bodies);
+          }
+          for (unsigned int i = 0; i < substeps; i++) {
+            kick(bodies, 0.5f * stepDelta);
+            drift(bodies, stepDelta);
+            computeAccelerations(bodies);
+            kick(bodies, 0.5f * stepDelta);
+          }
+          bodies.accelerationsValid = true;
+          break;
+
+        case Integrator::Yoshida4:
+          for (unsigned int i = 0; i < substeps; i++) {
+            for (int stage = 0; stage < 3; stage++) {
+              drift(bodies, YOSHIDA_DRIFT[stage] * stepDelta);
+              computeAccelerations(bodies);
+              kick(bodies, YOSHIDA_KICK[stage] * stepDelta);
+            }
+            drift(bodies, YOSHIDA_DRIFT[3] * stepDelta);
+          }
+          break;
+      }
+    }
+
+    // Kinetic plus pairwise potential energy, summed directly in double precision. O(N^2), meant
+    // for checking integrator drift rather than for use every frame.
+    double totalEnergy(const BodyStore &bodies) const {
+      double kinetic   = 0.0;
+      double potential = 0.0;
+      for (size_t i = 0; i < bodies.size(); i++) {
+        double speedSquared = double(bodies.velX[i]) * bodies.velX[i] +
+                              double(bodies.velY[i]) * bodies.velY[i];
+        kinetic += 0.5 * bodies.mass[i] * speedSquared;
+        for (size_t j = i + 1; j < bodies.size(); j++) {
+          double dx              = double(bodies.posX[j]) - bodies.posX[i];
+          double dy              = double(bodies.posY[j]) - bodies.posY[i];
+          double distanceSquared = dx * dx + dy * dy;
+          if (distanceSquared < 1e-10) {
+            continue;
+          }
+          potential -= strengthGravity * double(bodies.mass[i]) * bodies.mass[j] /
+                       std::sqrt(distanceSquared);
+        }
+      }
+      return kinetic + potential;
+    }
+
+    // per-body acceleration evaluations since construction
+    uint64_t forceEvaluations() const { return m_forceEvaluations; }
+
+    // timestep rung of every body after the last adaptive update, 0 takes the full substep
+    const std::vector<uint8_t> &rungs() const { return m_rungs; }
+
+  private:
+    // Bodies are split into fixed size blocks of targets, independent of the thread count. Each
+    // target sums every source in the same order whichever thread runs its block, and blocks write
+    // disjoint outputs, so results are bit-identical for any number of threads.
+    static constexpr size_t FORCE_BLOCK = 256;
+    static_assert(FORCE_BLOCK % BodyStore::PADDING == 0, "Force blocks must not split SIMD lanes");
+    // 2^MAX_RUNG ticks per substep still fit comfortably in a uint32_t
+    static constexpr uint32_t MAX_RUNG = 20;
+
+    // everything besides positions and masses that the accelerations depend on
+    struct ForceSettings {
+      GravitySolver solver;
+      float theta;
+      uint32_t meshResolution;
+      float meshSoftening;
+
+      bool operator==(const ForceSettings &) const = default;
+    };
+
+    ForceSettings forceSettings() const { return {solver, theta, meshResolution, meshSoftening}; }
+
+    void computeAccelerations(BodyStore &bodies) {
+      const size_t blockCount = (bodies.paddedSize() + FORCE_BLOCK - 1) / FORCE_BLOCK;
+      m_forceEvaluations += bodies.size();
+      m_forceSettings = forceSettings();
+
+      if (solver == GravitySolver::BarnesHut) {
+        m_quadTree.build(bodies.posX.data(), bodies.posY.data(), bodies.mass.data(), bodies.size());
+        forEachBlock(blockCount, [&](size_t block) {
+          const size_t end = std::min((block + 1) * FORCE_BLOCK, bodies.size());
+          for (size_t i = block * FORCE_BLOCK; i < end; i++) {
+            glm::vec2 acceleration =
+                m_quadTree.computeAcceleration({bodies.posX[i], bodies.posY[i]},
+                                               static_cast<uint32_t>(i),
+                                               theta,
+                                               strengthGravity);
+            bodies.accX[i] = acceleration.x;
+            bodies.accY[i] = acceleration.y;
+          }
+        });
+        return;
+      }
+
+      if (solver == GravitySolver::ParticleMesh) {
+        m_particleMesh.solve(bodies.posX.data(),
+                             bodies.posY.data(),
+                             bodies.mass.data(),
+                             bodies.size(),
+                             meshResolution,
+                             meshSoftening,
+                             strengthGravity,
+                             jobSystem);
+        forEachBlock(blockCount, [&](size_t block) {
+          const size_t end = std::min((block + 1) * FORCE_BLOCK, bodies.size());
+          for (size_t i = block * FORCE_BLOCK; i < end; i++) {
+            glm::vec2 acceleration =
+                m_particleMesh.sampleAcceleration({bodies.posX[i], bodies.posY[i]});
+            bodies.accX[i] = acceleration.x;
+            bodies.accY[i] = acceleration.y;
+          }
+        });
+        return;
+      }
+
+      // padding bodies are massless, so the kernel can run over the padded range as is
+      forEachBlock(blockCount, [&](size_t block) {
+        const size_t begin = block * FORCE_BLOCK;
+        const size_t end   = std::min(begin + FORCE_BLOCK, bodies.paddedSize());
+        directSumAccelerations(bodies.posX.data() + begin,
+                               bodies.posY.data() + begin,
+                               end - begin,
+                               bodies.posX.data(),
+                               bodies.posY.data(),
+                               bodies.mass.data(),
+                               bodies.paddedSize(),
+                               strengthGravity,
+                               bodies.accX.data() + begin,
+                               bodies.accY.data() + begin);
+      });
+    }
+
+    // Recomputes accelerations for the listed bodies only. Trees and meshes are still built from
+    // every body, the saving is in the per-target work.
+    void computeAccelerations(BodyStore &bodies, const std::vector<uint32_t> &active) {
+      const size_t activeCount = active.size();
+      const size_t blockCount  = (activeCount + FORCE_BLOCK - 1) / FORCE_BLOCK;
+      m_forceEvaluations += activeCount;
+
+      if (solver == GravitySolver::BarnesHut) {
+        m_quadTree.build(bodies.posX.data(), bodies.posY.data(), bodies.mass.data(), bodies.size());
+      } else if (solver == GravitySolver::ParticleMesh) {
+        m_particleMesh.solve(bodies.posX.data(),
+                             bodies.posY.data(),
+                             bodies.mass.data(),
+                             bodies.size(),
+                             meshResolution,
+                             meshSoftening,
+                             strengthGravity,
+                             jobSystem);
+      }
+
+      if (solver != GravitySolver::DirectSum) {
+        forEachBlock(blockCount, [&](size_t block) {
+          const size_t end = std::min((block + 1) * FORCE_BLOCK, activeCount);
+          for (size_t k = block * FORCE_BLOCK; k < end; k++) {
+            const uint32_t i = active[k];
+            glm::vec2 acceleration =
+                solver == GravitySolver::BarnesHut
+                    ? m_quadTree.computeAcceleration(
+                          {bodies.posX[i], bodies.posY[i]}, i, theta, strengthGravity)
+                    : m_particleMesh.sampleAcceleration({bodies.posX[i], bodies.posY[i]});
+            bodies.accX[i] = acceleration.x;
+            bodies.accY[i] = acceleration.y;
+          }
+        });
+        return;
+      }
+
+      // the kernel wants contiguous targets, so active bodies are gathered and scattered back
+      m_targets.resize(activeCount);
+      for (size_t k = 0; k < activeCount; k++) {
+        m_targets.posX[k] = bodies.posX[active[k]];
+        m_targets.posY[k] = bodies.posY[active[k]];
+      }
+      forEachBlock(blockCount, [&](size_t block) {
+        const size_t begin = block * FORCE_BLOCK;
+        const size_t end   = std::min(begin + FORCE_BLOCK, activeCount);
+        directSumAccelerations(m_targets.posX.data() + begin,
+                               m_targets.posY.data() + begin,
+                               end - begin,
+                               bodies.posX.data(),
+                               bodies.posY.data(),
+                               bodies.mass.data(),
+                               bodies.paddedSize(),
+                               strengthGravity,
+                               m_targets.accX.data() + begin,
+                               m_targets.accY.data() + begin);
+      });
+      for (size_t k = 0; k < activeCount; k++) {
+        bodies.accX[active[k]] = m_targets.accX[k];
+        bodies.accY[active[k]] = m_targets.accY[k];
+      }
+    }
+
+    // One substep of block timesteps, split into 2^maxRung ticks. A body on rung r is active
+    // every 2^(maxRung - r) ticks. Everyone drifts together, but drifts jump straight between
+    // ticks where the deepest occupied rung is active, as nothing is kicked in between. Bodies
+    // enter with accelerations and rungs for the current positions and leave the same way.
+    void stepBlocks(BodyStore &bodies, float stepDelta) {
+      const uint32_t tickCount = 1u << maxRung;
+      const float tickDelta    = stepDelta / static_cast<float>(tickCount);
+      auto halfKick            = [&](uint32_t i) {
+        const float delta = 0.5f * stepDelta / static_cast<float>(1u << m_rungs[i]);
+        bodies.velX[i] += delta * bodies.accX[i];
+        bodies.velY[i] += delta * bodies.accY[i];
+      };
+
+      uint8_t deepestRung = 0;
+      for (uint32_t i = 0; i < bodies.size(); i++) {
+        halfKick(i);
+        deepestRung = std::max(deepestRung, m_rungs[i]);
+      }
+
+      uint32_t tick = 0;
+      while (tick < tickCount) {
+        const uint32_t advance = tickCount >> deepestRung;
+        drift(bodies, static_cast<float>(advance) * tickDelta);
+        tick += advance;
+
+        m_active.clear();
+        for (uint32_t i = 0; i < bodies.size(); i++) {
+          if ((tick & ((tickCount >> m_rungs[i]) - 1)) == 0) {
+            m_active.push_back(i);
+          }
+        }
+        computeAccelerations(bodies, m_active);
+
+        // a body can always move to a deeper rung, but only to a shallower one whose step
+        // boundaries line up with the current tick
+        uint8_t alignedRung = 0;
+        if (tick < tickCount) {
+          uint32_t trailingZeros = 0;
+          while (((tick >> trailingZeros) & 1u) == 0) {
+            trailingZeros++;
+          }
+          alignedRung = static_cast<uint8_t>(maxRung - trailingZeros);
+        }
+        for (uint32_t i : m_active) {
+          halfKick(i);
+          m_rungs[i] = std::max(alignedRung, rungFor(bodies.accX[i], bodies.accY[i], stepDelta));
+          if (tick < tickCount) {
+            halfKick(i);
+          }
+        }
+
+        deepestRung = 0;
+        for (uint32_t i = 0; i < bodies.size(); i++) {
+          deepestRung = std::max(deepestRung, m_rungs[i]);
+        }
+      }
+    }
+
+    uint8_t rungFor(float accX, float accY, float stepDelta) const {
+      const float acceleration = std::sqrt(accX * accX + accY * accY);
+      if (!(acceleration > 0.0f)) {
+        return 0;
+      }
+      const float bodyDelta = std::sqrt(2.0f * timestepEta * timestepLength / acceleration);
+      if (bodyDelta >= stepDelta) {
+        return 0;
+      }
+      const float rung = std::ceil(std::log2(stepDelta / bodyDelta));
+      return static_cast<uint8_t>(std::min(rung, static_cast<float>(maxRung)));
+    }
+
+    template <typename Fn>
+    void forEachBlock(size_t blockCount, const Fn &fn) {
+      if (jobSystem != nullptr) {
+        jobSystem->parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+          for (size_t block = begin; block < end; block++) {
+            fn(block);
+          }
+        });
+        return;
+      }
+      for (size_t block = 0; block < blockCount; block++) {
+        fn(block);
+      }
+    }
+
+    // w1 = 1 / (2 - 2^(1/3)), w0 = -2^(1/3) * w1
+    static constexpr float YOSHIDA_DRIFT[4] = {0.67560359597982889f,
+                                               -0.17560359597982886f,
+                                               -0.17560359597982886f,
+                                               0.67560359597982889f};
+    static constexpr float YOSHIDA_KICK[3]  = {1.35120719195965777f,
+                                               -1.70241438391931532f,
+                                               1.35120719195965777f};
+
+    static void kick(BodyStore &bodies, float dt) {
+      for (size_t i = 0; i < bodies.size(); i++) {
+        bodies.velX[i] += dt * bodies.accX[i];
+        bodies.velY[i] += dt * bodies.accY[i];
+      }
+    }
+
+    static void drift(BodyStore &bodies, float dt) {
+      for (size_t i = 0; i < bodies.size(); i++) {
+        bodies.posX[i] += dt * bodies.velX[i];
+        bodies.posY[i] += dt * bodies.velY[i];
+      }
+    }
+
+    BodyStore m_bodies;
+    ForceSettings m_forceSettings{}; // of the last full force pass
+    QuadTree m_quadTree;
+    ParticleMesh m_particleMesh;
+    uint64_t m_forceEvaluations = 0;
+
+    std::vector<uint8_t> m_rungs;
+    std::vector<uint32_t> m_active;
+    BodyStore m_targets; // gathered active bodies for the direct-sum kernel
+  };
+} // namespace kopi
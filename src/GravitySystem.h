@@ -1,7 +1,17 @@
 #include "Application.h"
 
+#include "BodyStore.h"
+#include "GpuNBodySystem.h"
+#include "GravityPhysicsSystem.h"
 #include "Model.h"
+#include "NBodyKernel.h"
 #include "RenderSystem.h"
+#include "SimulationThread.h"
+#include "SystemScheduler.h"
+#include "JobSystem.h"
+#include "TransformSystem.h"
+#include "Vec2FieldSystem.h"
+#include "World.h"
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -9,9 +19,16 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace kopi {
   static inline glm::vec3 hsv2rgb(float h, float s, float v) {
@@ -49,209 +66,215 @@ namespace kopi {
     return {r + m, g + m, b + m};
   }
 
-  class GravityPhysicsSystem {
-  public:
-    GravityPhysicsSystem(float strength) : strengthGravity{strength} {}
-
-    const float strengthGravity;
-
-    void update(std::vector<GameObject> &objs, float dt, unsigned int substeps = 1) {
-      const float stepDelta = dt / substeps;
-      for (int i = 0; i < substeps; i++) {
-        stepSimulation(objs, stepDelta);
-      }
-    }
-
-    glm::vec2 computeForce(GameObject &fromObj, GameObject &toObj) const {
-      auto offset           = fromObj.transform2d.translation - toObj.transform2d.translation;
-      float distanceSquared = glm::dot(offset, offset);
-
-      if (glm::abs(distanceSquared) < 1e-10f) {
-        return {.0f, .0f};
-      }
-
-      float force =
-          strengthGravity * toObj.rigidBody2d.mass * fromObj.rigidBody2d.mass / distanceSquared;
-      return force * offset / glm::sqrt(distanceSquared);
-    }
-
-  private:
-    void stepSimulation(std::vector<GameObject> &physicsObjs, float dt) {
-      for (auto iterA = physicsObjs.begin(); iterA != physicsObjs.end(); ++iterA) {
-        auto &objA = *iterA;
-        for (auto iterB = iterA; iterB != physicsObjs.end(); ++iterB) {
-          if (iterA == iterB) {
-            continue;
-          }
-          auto &objB = *iterB;
-
-          auto force = computeForce(objA, objB);
-          objA.rigidBody2d.velocity += dt * -force / objA.rigidBody2d.mass;
-          objB.rigidBody2d.velocity += dt * force / objB.rigidBody2d.mass;
-        }
-      }
-
-      for (auto &obj : physicsObjs) {
-        obj.transform2d.translation += dt * obj.rigidBody2d.velocity;
-      }
-    }
-  };
-
-  class Vec2FieldSystem {
-  public:
-    void update(const GravityPhysicsSystem &physicsSystem,
-                std::vector<GameObject> &physicsObjs,
-                std::vector<GameObject> &vectorField) {
-      for (auto &vf : vectorField) {
-        glm::vec2 direction{};
-        for (auto &obj : physicsObjs) {
-          direction += physicsSystem.computeForce(obj, vf);
-        }
-
-        // magnitude-based scale (keep your existing curve)
-        float mag              = glm::length(direction);
-        float mag01            = glm::clamp(glm::log(mag + 1.0f) / 3.0f, 0.0f, 1.0f);
-        vf.transform2d.scale.x = 0.005f + 0.045f * mag01;
-
-        // orientation
-        vf.transform2d.rotation = atan2(direction.y, direction.x);
-
-        // Colour driven only by gravity (acceleration magnitude at this point)
-        float accelMag = 0.0f;
-        for (auto &obj : physicsObjs) {
-          glm::vec2 d = obj.transform2d.translation - vf.transform2d.translation;
-          float r2    = glm::dot(d, d);
-          if (r2 < 1e-10f)
-            continue;
-          accelMag += physicsSystem.strengthGravity * obj.rigidBody2d.mass / r2; // a = G * M / r^2
-        }
-
-        // Map accelMag -> [0,1] using a gentle log curve
-        float a01 = glm::clamp(glm::log(accelMag + 1.0f) / 3.0f, 0.0f, 1.0f);
-
-        // Gradient (blue→green→red) by acceleration only
-        glm::vec3 c0 = {0.0f, 0.1f, 0.8f};
-        glm::vec3 c1 = {0.0f, 1.0f, 0.0f};
-        glm::vec3 c2 = {1.0f, 0.0f, 0.0f};
-        vf.color =
-            (a01 < 0.5f) ? glm::mix(c0, c1, a01 * 2.0f) : glm::mix(c1, c2, (a01 - 0.5f) * 2.0f);
-      }
-    }
-  };
-
-  std::unique_ptr<Model> createSquareModel(EngineDevice &device, glm::vec2 offset) {
+  std::unique_ptr<Model>
+  createSquareModel(EngineDevice &device, StagingRing &staging, glm::vec2 offset) {
     std::vector<Model::Vertex> vertices = {
-        {{-0.5f, -0.5f}},
-        {{0.5f, 0.5f}},
-        {{-0.5f, 0.5f}},
         {{-0.5f, -0.5f}},
         {{0.5f, -0.5f}},
-        {{0.5f, 0.5f}}, //
+        {{0.5f, 0.5f}},
+        {{-0.5f, 0.5f}}, //
     };
     for (auto &v : vertices) {
       v.position += offset;
     }
-    return std::make_unique<Model>(device, vertices);
+    std::vector<uint32_t> indices = {0, 2, 3, 0, 1, 2};
+    return std::make_unique<Model>(device, staging, vertices, indices);
   }
 
-  std::unique_ptr<Model> createCircleModel(EngineDevice &device, unsigned int numSides) {
-    std::vector<Model::Vertex> uniqueVertices{};
+  std::unique_ptr<Model>
+  createCircleModel(EngineDevice &device, StagingRing &staging, unsigned int numSides) {
+    std::vector<Model::Vertex> vertices{};
     for (int i = 0; i < numSides; i++) {
       float angle = i * glm::two_pi<float>() / numSides;
-      uniqueVertices.push_back({
+      vertices.push_back({
           {glm::cos(angle), glm::sin(angle)}
       });
     }
-    uniqueVertices.push_back({});
-
-    std::vector<Model::Vertex> vertices{};
-    for (int i = 0; i < numSides; i++) {
-      vertices.push_back(uniqueVertices[i]);
-      vertices.push_back(uniqueVertices[(i + 1) % numSides]);
-      vertices.push_back(uniqueVertices[numSides]);
+    vertices.push_back({});
+
+    // a fan around the centre, which is the last vertex
+    std::vector<uint32_t> indices{};
+    for (uint32_t i = 0; i < numSides; i++) {
+      indices.push_back(i);
+      indices.push_back((i + 1) % numSides);
+      indices.push_back(numSides);
     }
-    return std::make_unique<Model>(device, vertices);
+    return std::make_unique<Model>(device, staging, vertices, indices);
   }
 
-  Application::Application() { loadGameObjects(); }
+  Application::Application() {}
 
   Application::~Application() {}
 
   void Application::run() {
 
-    std::shared_ptr<Model> squareModel = createSquareModel(m_device, {.5f, .0f});
-    std::shared_ptr<Model> circleModel = createCircleModel(m_device, 64);
+    std::shared_ptr<Model> squareModel = createSquareModel(m_device, m_staging, {.5f, .0f});
+    std::shared_ptr<Model> circleModel = createCircleModel(m_device, m_staging, 64);
+
+    World world;
+    Transform2dComponent red{};
+    red.scale       = glm::vec2{.05f};
+    red.translation = {.5f, .5f};
+    world.create(red,
+                 RigidBody2dComponent{{-.5f, .0f}},
+                 ColourComponent{{1.f, 0.f, 0.f}},
+                 ModelComponent{circleModel});
+    Transform2dComponent blue{};
+    blue.scale       = glm::vec2{.05f};
+    blue.translation = {-.45f, -.25f};
+    world.create(blue,
+                 RigidBody2dComponent{{.5f, .0f}},
+                 ColourComponent{{0.f, 0.f, 1.f}},
+                 ModelComponent{circleModel});
 
-    std::vector<GameObject> physicsObjects{};
-    auto red                    = GameObject::createGameObject();
-    red.transform2d.scale       = glm::vec2{.05f};
-    red.transform2d.translation = {.5f, .5f};
-    red.color                   = {1.f, 0.f, 0.f};
-    red.rigidBody2d.velocity    = {-.5f, .0f};
-    red.model                   = circleModel;
-    physicsObjects.push_back(std::move(red));
-    auto blue                    = GameObject::createGameObject();
-    blue.transform2d.scale       = glm::vec2{.05f};
-    blue.transform2d.translation = {-.45f, -.25f};
-    blue.color                   = {0.f, 0.f, 1.f};
-    blue.rigidBody2d.velocity    = {.5f, .0f};
-    blue.model                   = circleModel;
-    physicsObjects.push_back(std::move(blue));
-
-    std::vector<GameObject> vectorField{};
     int gridCount = 40;
     for (int i = 0; i < gridCount; i++) {
       for (int j = 0; j < gridCount; j++) {
-        auto vf                    = GameObject::createGameObject();
-        vf.transform2d.scale       = glm::vec2(0.005f);
-        vf.transform2d.translation = {-1.0f + ((i + 0.5f) * 2.0f / gridCount),
-                                      -1.0f + (j + 0.5f) * 2.0f / gridCount};
-        vf.color                   = glm::vec3(1.0f);
-        vf.model                   = squareModel;
-        vectorField.push_back(std::move(vf));
+        Transform2dComponent vf{};
+        vf.scale       = glm::vec2(0.005f);
+        vf.translation = {-1.0f + ((i + 0.5f) * 2.0f / gridCount),
+                          -1.0f + (j + 0.5f) * 2.0f / gridCount};
+        world.create(vf,
+                     ColourComponent{glm::vec3(1.0f)},
+                     ModelComponent{squareModel},
+                     FieldSampleComponent{});
       }
     }
 
+    // the simulation thread and the frame loop both submit to one scheduler, whichever has more
+    // work at the moment gets more of the cores
+    JobSystem jobSystem{};
     GravityPhysicsSystem gravitySystem{0.81f};
+    gravitySystem.jobSystem  = &jobSystem;
+    gravitySystem.integrator = Integrator::Yoshida4;
     Vec2FieldSystem vecFieldSystem{};
+    vecFieldSystem.jobSystem   = &jobSystem;
+    vecFieldSystem.lazyUpdates = true;
+    // one per archetype, so neither waits on the other
+    TransformSystem bodyTransforms{};
+    bodyTransforms.jobSystem = &jobSystem;
+    TransformSystem sampleTransforms{};
+    sampleTransforms.jobSystem = &jobSystem;
+
+    BodyStore bodies;
+    bodies.loadFrom(world);
+    auto stepGravity = [&](BodyStore &store, float dt) { gravitySystem.update(store, dt, 1); };
+    SimulationThread simulation{std::move(bodies), 1.f / 60, stepGravity};
+
+    // the systems below request their pipelines as they are built
+    const auto pipelinesRequested = std::chrono::steady_clock::now();
+
+    // KOPI_GPU_NBODY moves the bodies onto the device, the CPU never sees their positions again so
+    // the vector field is left out in that mode
+    std::unique_ptr<GpuNBodySystem> gpuNBodySystem;
+    if (std::getenv("KOPI_GPU_NBODY") != nullptr) {
+      gpuNBodySystem = std::make_unique<GpuNBodySystem>(m_device,
+                                                        m_staging,
+                                                        m_pipelines,
+                                                        m_renderer.getSwapChainRenderPass(),
+                                                        world,
+                                                        gravitySystem.strengthGravity);
+    } else {
+      simulation.start();
+    }
 
-    RenderSystem m_renderSystem{m_device, m_renderer.getSwapChainRenderPass()};
+    RenderSystem m_renderSystem{m_pipelines, m_renderer.getSwapChainRenderPass()};
+    // every upload so far, the models' and the GPU bodies', goes out in one transfer submission
+    m_staging.flush();
+    const MemoryStats memory = m_device.memoryStats();
+    LOG_INFO("Device memory: {} allocations in {} blocks, {} of {} KiB used, fragmentation {:.2f}",
+             memory.allocationCount,
+             memory.blockCount,
+             memory.bytesUsed >> 10,
+             memory.bytesReserved >> 10,
+             memory.fragmentation());
+    // The first frames would only skip draws until these compile, so waiting here costs nothing
+    // and tells how long a start takes with the pipeline cache cold or warm.
+    m_pipelines.waitIdle();
+    LOG_INFO("Startup pipelines: {} ready after {:.1f} ms, pipeline cache {}",
+             m_pipelines.size(),
+             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                       pipelinesRequested)
+                 .count(),
+             m_device.pipelineCacheWarm() ? "warm" : "cold");
+
+    // Frame systems with the components they touch. Bodies and arrows live in different
+    // archetypes, and the scheduler only orders systems that share one, so adding a system that
+    // touches just one of the two lets it run next to whatever handles the other. The graph is
+    // interpolate, then the vector field, then the body and sample transforms side by side, then
+    // render.
+    constexpr ComponentMask transform = componentMask<Transform2dComponent>();
+    constexpr ComponentMask bodyQuery =
+        componentMask<Transform2dComponent, RigidBody2dComponent>();
+    constexpr ComponentMask sampleQuery =
+        componentMask<Transform2dComponent, ColourComponent, FieldSampleComponent>();
+    constexpr ComponentMask drawQuery =
+        componentMask<Transform2dComponent, ColourComponent, ModelComponent>();
+    bodyTransforms.query   = bodyQuery;
+    sampleTransforms.query = sampleQuery;
+
+    VkCommandBuffer frameCommandBuffer = VK_NULL_HANDLE;
+    SystemScheduler frameSystems;
+    frameSystems.add("interpolate", {{bodyQuery, 0, transform}}, [&](World &world) {
+      simulation.interpolate(world);
+    });
+    constexpr ComponentMask fieldWrites = componentMask<Transform2dComponent, ColourComponent>();
+    frameSystems.add("vector field",
+                     {{bodyQuery, bodyQuery, 0}, {sampleQuery, sampleQuery, fieldWrites}},
+                     [&](World &world) {
+                       // strengthGravity is const, safe to read next to the simulation thread
+                       vecFieldSystem.update(gravitySystem.strengthGravity, world);
+                     });
+    // after the vector field, which reads the body transforms and writes the sample ones
+    frameSystems.add("sample transforms", {{sampleQuery, transform, transform}}, [&](World &world) {
+      sampleTransforms.update(world);
+    });
+    frameSystems.add("body transforms", {{bodyQuery, transform, transform}}, [&](World &world) {
+      bodyTransforms.update(world);
+    });
+    // KOPI_PARALLEL_DRAWS draws entity by entity, recorded across the job system's threads,
+    // instead of instanced
+    const bool parallelDraws = std::getenv("KOPI_PARALLEL_DRAWS") != nullptr;
+    // only reads the World, the command buffer belongs to this system until the graph is done
+    frameSystems.add("render", {{drawQuery, drawQuery, 0}}, [&](World &world) {
+      if (parallelDraws) {
+        m_renderer.beginSwapChainRenderPass(frameCommandBuffer,
+                                            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        m_renderSystem.renderEntitiesParallel(m_renderer, frameCommandBuffer, &jobSystem, world);
+      } else {
+        m_renderer.beginSwapChainRenderPass(frameCommandBuffer);
+        m_renderSystem.renderEntitiesInstanced(frameCommandBuffer,
+                                               m_renderer.getFrameData(),
+                                               world);
+      }
+      m_renderer.endSwapChainRenderPass(frameCommandBuffer);
+    });
 
     while (!m_window.shouldClose()) {
       glfwPollEvents();
 
       if (auto commandBuffer = m_renderer.beginFrame()) {
+        // free once the uploads have landed, which they normally have long before
+        m_renderer.addTimelineWait(m_staging.pendingWait());
+
+        if (gpuNBodySystem) {
+          gpuNBodySystem->dispatch(commandBuffer, 1.f / 60);
 
-        gravitySystem.update(physicsObjects, 1.f / 60, 5);
-        vecFieldSystem.update(gravitySystem, physicsObjects, vectorField);
+          m_renderer.beginSwapChainRenderPass(commandBuffer);
+          gpuNBodySystem->render(commandBuffer, *circleModel, .05f);
+          m_renderer.endSwapChainRenderPass(commandBuffer);
+          m_renderer.endFrame();
+          continue;
+        }
 
-        m_renderer.beginSwapChainRenderPass(commandBuffer);
-        m_renderSystem.renderGameObjects(commandBuffer, physicsObjects);
-        m_renderSystem.renderGameObjects(commandBuffer, vectorField);
-        m_renderer.endSwapChainRenderPass(commandBuffer);
+        frameCommandBuffer = commandBuffer;
+        frameSystems.run(world, &jobSystem);
         m_renderer.endFrame();
       }
     }
 
+    simulation.stop();
     vkDeviceWaitIdle(m_device.device());
   }
 
-  void Application::loadGameObjects() {
-    std::vector<Model::Vertex> vertices{
-        {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-        {{0.5f, 0.5f},  {0.0f, 1.0f, 0.0f}},
-        {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
-    };
-    auto m_model = std::make_shared<Model>(m_device, vertices);
-
-    auto triangle                      = GameObject::createGameObject();
-    triangle.model                     = m_model;
-    triangle.color                     = {.1f, .8f, .1f};
-    triangle.transform2d.translation.x = .2f;
-    triangle.transform2d.scale         = {2.f, .5f};
-    triangle.transform2d.rotation      = .25f * glm::two_pi<float>();
-
-    m_gameObjects.push_back(std::move(triangle));
-  }
-
 } // namespace kopi
\ No newline at end of file
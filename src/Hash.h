@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace kopi {
+  // 64 bit FNV-1a. Fast and stable across runs and platforms, which cache keys and file checksums
+  // need, but no defence against crafted collisions.
+  class Hasher {
+  public:
+    Hasher &bytes(const void *data, size_t size) {
+      const auto *byte = static_cast<const unsigned char *>(data);
+      for (size_t i = 0; i < size; i++) {
+        m_hash = (m_hash ^ byte[i]) * 1099511628211ull;
+      }
+      return *this;
+    }
+
+    // Scalars only, structs would bring their padding and pointers into the hash.
+    template <typename T> Hasher &add(const T &value) {
+      static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>,
+                    "hash struct members one by one");
+      return bytes(&value, sizeof(T));
+    }
+
+    // Length first, so "ab" + "c" and "a" + "bc" differ.
+    Hasher &add(std::string_view text) {
+      add(text.size());
+      return bytes(text.data(), text.size());
+    }
+    Hasher &add(const std::string &text) { return add(std::string_view{text}); }
+
+    uint64_t value() const { return m_hash; }
+
+  private:
+    uint64_t m_hash = 14695981039346656037ull;
+  };
+
+  inline uint64_t hashBytes(const void *data, size_t size) {
+    return Hasher{}.bytes(data, size).value();
+  }
+} // namespace kopi
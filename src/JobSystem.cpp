@@ -0,0 +1,277 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace kopi {
+  // idle rounds a worker spins through before it goes to sleep
+  static constexpr int SPIN_COUNT = 64;
+
+  // which worker of which system the current thread is, owner is null outside any pool
+  struct WorkerIdentity {
+    const JobSystem *owner = nullptr;
+    size_t index           = 0;
+  };
+  static thread_local WorkerIdentity t_worker;
+
+  JobSystem::JobSystem(unsigned int threadCount) {
+    threadCount = std::max(threadCount, 1u);
+    m_queues.reserve(threadCount - 1);
+    for (unsigned int i = 1; i < threadCount; i++) {
+      m_queues.push_back(std::make_unique<Worker>());
+    }
+    m_workers.reserve(threadCount - 1);
+    for (size_t i = 0; i + 1 < threadCount; i++) {
+      m_workers.emplace_back([this, i] { workerLoop(i); });
+    }
+  }
+
+  JobSystem::~JobSystem() {
+    {
+      std::lock_guard<std::mutex> lock(m_sleepMutex);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  JobHandle JobSystem::schedule(std::function<void()> fn,
+                                std::initializer_list<JobHandle> dependencies) {
+    return schedule(std::move(fn), dependencies.begin(), dependencies.size());
+  }
+
+  JobHandle JobSystem::schedule(std::function<void()> fn,
+                                const std::vector<JobHandle> &dependencies) {
+    return schedule(std::move(fn), dependencies.data(), dependencies.size());
+  }
+
+  JobHandle JobSystem::schedule(std::function<void()> fn,
+                                const JobHandle *dependencies,
+                                size_t dependencyCount) {
+    auto job  = std::make_shared<Job>();
+    job->m_fn = std::move(fn);
+    for (size_t i = 0; i < dependencyCount; i++) {
+      Job *dependency = dependencies[i].get();
+      if (dependency == nullptr) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(dependency->m_mutex);
+      if (!dependency->m_finished.load(std::memory_order_relaxed)) {
+        job->m_pending.fetch_add(1, std::memory_order_relaxed);
+        dependency->m_dependents.push_back(job);
+      } else if (dependency->m_exception != nullptr) {
+        inherit(*job, dependency->m_exception);
+      }
+    }
+
+    // drop the scheduling reference, whichever dependency finishes last queues it otherwise
+    if (job->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      enqueue(job);
+    }
+    return job;
+  }
+
+  void JobSystem::wait(const JobHandle &job) {
+    drain(job);
+    if (job->m_exception != nullptr) {
+      std::rethrow_exception(job->m_exception);
+    }
+  }
+
+  void JobSystem::wait(const std::vector<JobHandle> &jobs) {
+    std::exception_ptr exception;
+    for (auto &job : jobs) {
+      drain(job);
+      if (exception == nullptr) {
+        exception = job->m_exception;
+      }
+    }
+    if (exception != nullptr) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  void JobSystem::drain(const JobHandle &job) {
+    while (!job->finished()) {
+      if (JobHandle next = take()) {
+        run(next);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  void JobSystem::parallelFor(size_t count,
+                              size_t grain,
+                              const std::function<void(size_t, size_t)> &fn) {
+    grain                   = std::max<size_t>(grain, 1);
+    const size_t rangeCount = (count + grain - 1) / grain;
+    if (m_workers.empty() || rangeCount <= 1) {
+      for (size_t begin = 0; begin < count; begin += grain) {
+        fn(begin, std::min(begin + grain, count));
+      }
+      return;
+    }
+
+    // one job per helping thread rather than per range, each pulls ranges until none are left. The
+    // helpers reference this frame, so it must not unwind before every one of them has finished.
+    std::atomic<size_t> nextRange{0};
+    auto runRanges = [&] {
+      size_t range;
+      while ((range = nextRange.fetch_add(1, std::memory_order_relaxed)) < rangeCount) {
+        const size_t begin = range * grain;
+        try {
+          fn(begin, std::min(begin + grain, count));
+        } catch (...) {
+          nextRange.store(rangeCount, std::memory_order_relaxed);
+          throw;
+        }
+      }
+    };
+
+    const size_t helperCount = std::min<size_t>(rangeCount, threadCount()) - 1;
+    std::vector<JobHandle> helpers;
+    helpers.reserve(helperCount);
+    for (size_t i = 0; i < helperCount; i++) {
+      helpers.push_back(schedule(runRanges));
+    }
+    std::exception_ptr exception;
+    try {
+      runRanges();
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    for (auto &helper : helpers) {
+      drain(helper);
+      if (exception == nullptr) {
+        exception = helper->m_exception;
+      }
+    }
+    if (exception != nullptr) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  void JobSystem::workerLoop(size_t index) {
+    t_worker = {this, index};
+    int idleRounds = 0;
+    while (true) {
+      if (JobHandle job = take()) {
+        run(job);
+        idleRounds = 0;
+        continue;
+      }
+      if (++idleRounds < SPIN_COUNT) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      // m_sleeping goes up before m_queued is checked and enqueue bumps m_queued before it reads
+      // m_sleeping, so a job queued in between always finds this worker to wake
+      std::unique_lock<std::mutex> lock(m_sleepMutex);
+      m_sleeping.fetch_add(1);
+      m_wake.wait(lock, [this] { return m_stop || m_queued.load() > 0; });
+      m_sleeping.fetch_sub(1);
+      if (m_stop && m_queued.load() == 0) {
+        return;
+      }
+      idleRounds = 0;
+    }
+  }
+
+  void JobSystem::enqueue(JobHandle job) {
+    if (t_worker.owner == this) {
+      Worker &worker = *m_queues[t_worker.index];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.jobs.push_back(std::move(job));
+    } else {
+      std::lock_guard<std::mutex> lock(m_sharedMutex);
+      m_shared.push_back(std::move(job));
+    }
+
+    m_queued.fetch_add(1);
+    if (m_sleeping.load() > 0) {
+      std::lock_guard<std::mutex> lock(m_sleepMutex);
+      m_wake.notify_one();
+    }
+  }
+
+  // a job keeps the first failure among its dependencies
+  void JobSystem::inherit(Job &job, const std::exception_ptr &exception) {
+    std::lock_guard<std::mutex> lock(job.m_mutex);
+    if (job.m_exception == nullptr) {
+      job.m_exception = exception;
+    }
+  }
+
+  // own deque newest first, which keeps a job's children hot in cache, then the shared queue, then
+  // the oldest job of the other workers
+  JobHandle JobSystem::take() {
+    if (m_queued.load(std::memory_order_relaxed) == 0) {
+      return nullptr;
+    }
+
+    JobHandle job;
+    const bool isWorker = t_worker.owner == this;
+    const size_t self   = isWorker ? t_worker.index : 0;
+    if (isWorker) {
+      Worker &worker = *m_queues[self];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      if (!worker.jobs.empty()) {
+        job = std::move(worker.jobs.back());
+        worker.jobs.pop_back();
+      }
+    }
+    if (!job) {
+      std::lock_guard<std::mutex> lock(m_sharedMutex);
+      if (!m_shared.empty()) {
+        job = std::move(m_shared.front());
+        m_shared.pop_front();
+      }
+    }
+    for (size_t i = 1; !job && i <= m_queues.size(); i++) {
+      Worker &victim = *m_queues[(self + i) % m_queues.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.jobs.empty()) {
+        job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+      }
+    }
+
+    if (job) {
+      m_queued.fetch_sub(1);
+    }
+    return job;
+  }
+
+  // Every job finishes, thrown or not. An exception escaping a worker would terminate and one
+  // escaping a waiting thread would leave the job unfinished with its dependents stuck behind it.
+  void JobSystem::run(const JobHandle &job) {
+    // a failed dependency was written under the mutex before the last one released m_pending
+    if (job->m_exception == nullptr) {
+      try {
+        job->m_fn();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(job->m_mutex);
+        job->m_exception = std::current_exception();
+      }
+    }
+    job->m_fn = nullptr;
+
+    std::vector<JobHandle> dependents;
+    {
+      std::lock_guard<std::mutex> lock(job->m_mutex);
+      job->m_finished.store(true, std::memory_order_release);
+      dependents.swap(job->m_dependents);
+    }
+    for (auto &dependent : dependents) {
+      if (job->m_exception != nullptr) {
+        inherit(*dependent, job->m_exception);
+      }
+      if (dependent->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        enqueue(std::move(dependent));
+      }
+    }
+  }
+} // namespace kopi
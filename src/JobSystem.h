@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kopi {
+  class JobSystem;
+
+  // One unit of work. A job becomes runnable once every job it depends on has finished, and the
+  // handle stays valid after it ran so it can still be waited on or depended upon.
+  //
+  // A job that throws still finishes. The exception is kept on the job and handed on to its
+  // dependents, which then finish without running.
+  class Job {
+  public:
+    bool finished() const { return m_finished.load(std::memory_order_acquire); }
+    // Only meaningful once finished.
+    bool failed() const { return m_exception != nullptr; }
+
+  private:
+    friend class JobSystem;
+
+    std::function<void()> m_fn;
+    // unfinished dependencies, plus one held while the job is being scheduled
+    std::atomic<uint32_t> m_pending{1};
+    std::atomic<bool> m_finished{false};
+    // what the job or the first failed dependency threw, written before the job finishes
+    std::exception_ptr m_exception;
+    std::mutex m_mutex; // guards m_dependents and m_exception against the job finishing
+    std::vector<std::shared_ptr<Job>> m_dependents;
+  };
+
+  using JobHandle = std::shared_ptr<Job>;
+
+  // Work-stealing scheduler. Every worker owns a deque, it pushes and pops its own jobs at the back
+  // and steals the oldest job from the front of another worker's deque when it runs dry. Threads
+  // outside the pool, the main thread and the simulation thread, submit through a shared queue.
+  //
+  // wait() never blocks while there is work: the waiting thread runs queued jobs until the one it
+  // waits on is done, so any thread can wait, including a job on a worker.
+  class JobSystem {
+  public:
+    // threadCount includes the thread that waits, so N - 1 workers are spawned
+    explicit JobSystem(unsigned int threadCount = std::thread::hardware_concurrency());
+    ~JobSystem();
+
+    JobSystem(const JobSystem &)            = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    unsigned int threadCount() const { return static_cast<unsigned int>(m_workers.size()) + 1; }
+
+    // Queues fn to run once every job in dependencies has finished. Null handles are ignored.
+    JobHandle schedule(std::function<void()> fn,
+                       std::initializer_list<JobHandle> dependencies = {});
+    JobHandle schedule(std::function<void()> fn, const std::vector<JobHandle> &dependencies);
+
+    // Runs other jobs on the calling thread until job has finished, then rethrows what it threw.
+    void wait(const JobHandle &job);
+    // Waits for every job, even after one has failed, then rethrows the first failure in order.
+    void wait(const std::vector<JobHandle> &jobs);
+
+    // Calls fn(begin, end) over [0, count) in ranges of at most grain and returns when all have
+    // finished. Ranges are handed out dynamically, so fn must not depend on which thread runs one.
+    // Once fn throws no further ranges start, and the exception is rethrown after the ranges
+    // already running have returned.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+  private:
+    // a worker's own deque, the mutex is only contended when somebody steals
+    struct Worker {
+      std::mutex mutex;
+      std::deque<JobHandle> jobs;
+    };
+
+    JobHandle schedule(std::function<void()> fn,
+                       const JobHandle *dependencies,
+                       size_t dependencyCount);
+    // wait() without the rethrow
+    void drain(const JobHandle &job);
+    void workerLoop(size_t index);
+    void enqueue(JobHandle job);
+    JobHandle take();
+    void run(const JobHandle &job);
+    static void inherit(Job &job, const std::exception_ptr &exception);
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<Worker>> m_queues;
+
+    std::mutex m_sharedMutex; // queue for jobs scheduled from outside the pool
+    std::deque<JobHandle> m_shared;
+
+    // queued jobs over all deques, idle workers sleep on m_wake while it is zero
+    std::atomic<size_t> m_queued{0};
+    std::atomic<unsigned int> m_sleeping{0};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_stop{false};
+  };
+} // namespace kopi
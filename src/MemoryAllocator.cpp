@@ -0,0 +1,356 @@
+#include "MemoryAllocator.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace kopi {
+  static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+
+  TlsfAllocator::TlsfAllocator(uint64_t size)
+      : m_size{size / GRANULARITY * GRANULARITY}, m_heads(FL_COUNT * SL_COUNT, NONE) {
+    ASSERT_LOG(m_size > 0, "TLSF range must hold at least {} bytes", GRANULARITY);
+    const uint32_t range   = newRange();
+    m_ranges[range].offset = 0;
+    m_ranges[range].size   = m_size;
+    insertFree(range);
+  }
+
+  void TlsfAllocator::mapping(uint64_t size, uint32_t &fl, uint32_t &sl) {
+    fl = static_cast<uint32_t>(63 - std::countl_zero(size));
+    sl = static_cast<uint32_t>(size >> (fl - SL_BITS)) & (SL_COUNT - 1);
+  }
+
+  uint32_t TlsfAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t &offset) {
+    ASSERT_LOG(std::has_single_bit(alignment), "Alignment {} is not a power of two", alignment);
+    size      = alignUp(std::max<uint64_t>(size, 1), GRANULARITY);
+    alignment = std::max(alignment, GRANULARITY);
+    // offsets are already multiples of GRANULARITY, anything coarser may need padding in front
+    const uint64_t needed = size + alignment - GRANULARITY;
+    if (needed > m_size) {
+      return NONE;
+    }
+
+    // round up to the next class boundary, so every range in the class found is large enough
+    uint32_t fl;
+    uint32_t sl;
+    mapping(needed, fl, sl);
+    const uint64_t rounded = needed + (1ull << (fl - SL_BITS)) - 1;
+    mapping(rounded, fl, sl);
+
+    uint32_t slMap = fl < FL_COUNT ? m_slBitmaps[fl] & (~0u << sl) : 0;
+    if (slMap == 0) {
+      const uint64_t flMap = fl + 1 < FL_COUNT ? m_flBitmap & (~0ull << (fl + 1)) : 0;
+      if (flMap == 0) {
+        return NONE;
+      }
+      fl    = static_cast<uint32_t>(std::countr_zero(flMap));
+      slMap = m_slBitmaps[fl];
+    }
+    sl = static_cast<uint32_t>(std::countr_zero(slMap));
+
+    uint32_t range = m_heads[fl * SL_COUNT + sl];
+    removeFree(range);
+
+    const uint64_t padding = alignUp(m_ranges[range].offset, alignment) - m_ranges[range].offset;
+    if (padding > 0) {
+      // the padding stays behind as a free range of its own
+      const uint32_t front = range;
+      splitTail(front, padding);
+      range = m_ranges[front].nextPhysical;
+      removeFree(range);
+      insertFree(front);
+    }
+    if (m_ranges[range].size > size) {
+      splitTail(range, size);
+    }
+
+    m_ranges[range].free = false;
+    m_usedBytes += m_ranges[range].size;
+    m_allocationCount++;
+    offset = m_ranges[range].offset;
+    return range;
+  }
+
+  void TlsfAllocator::free(uint32_t allocation) {
+    ASSERT_LOG(allocation < m_ranges.size() && !m_ranges[allocation].free,
+               "Range {} is not allocated",
+               allocation);
+    uint32_t range = allocation;
+    m_usedBytes -= m_ranges[range].size;
+    m_allocationCount--;
+
+    const uint32_t next = m_ranges[range].nextPhysical;
+    if (next != NONE && m_ranges[next].free) {
+      removeFree(next);
+      m_ranges[range].size += m_ranges[next].size;
+      m_ranges[range].nextPhysical = m_ranges[next].nextPhysical;
+      if (m_ranges[next].nextPhysical != NONE) {
+        m_ranges[m_ranges[next].nextPhysical].prevPhysical = range;
+      }
+      m_unusedRanges.push_back(next);
+    }
+
+    const uint32_t prev = m_ranges[range].prevPhysical;
+    if (prev != NONE && m_ranges[prev].free) {
+      removeFree(prev);
+      m_ranges[prev].size += m_ranges[range].size;
+      m_ranges[prev].nextPhysical = m_ranges[range].nextPhysical;
+      if (m_ranges[range].nextPhysical != NONE) {
+        m_ranges[m_ranges[range].nextPhysical].prevPhysical = prev;
+      }
+      m_unusedRanges.push_back(range);
+      range = prev;
+    }
+    insertFree(range);
+  }
+
+  uint64_t TlsfAllocator::largestFreeRange() const {
+    if (m_flBitmap == 0) {
+      return 0;
+    }
+    // the top class only bounds the size from below, so walk its lists
+    const uint32_t fl = static_cast<uint32_t>(63 - std::countl_zero(m_flBitmap));
+    uint64_t largest  = 0;
+    for (uint32_t sl = 0; sl < SL_COUNT; sl++) {
+      uint32_t range = m_heads[fl * SL_COUNT + sl];
+      while (range != NONE) {
+        largest = std::max(largest, m_ranges[range].size);
+        range   = m_ranges[range].nextFree;
+      }
+    }
+    return largest;
+  }
+
+  uint32_t TlsfAllocator::newRange() {
+    if (!m_unusedRanges.empty()) {
+      const uint32_t range = m_unusedRanges.back();
+      m_unusedRanges.pop_back();
+      m_ranges[range] = Range{};
+      return range;
+    }
+    m_ranges.emplace_back();
+    return static_cast<uint32_t>(m_ranges.size() - 1);
+  }
+
+  void TlsfAllocator::insertFree(uint32_t range) {
+    uint32_t fl;
+    uint32_t sl;
+    mapping(m_ranges[range].size, fl, sl);
+    uint32_t &head = m_heads[fl * SL_COUNT + sl];
+
+    m_ranges[range].free     = true;
+    m_ranges[range].prevFree = NONE;
+    m_ranges[range].nextFree = head;
+    if (head != NONE) {
+      m_ranges[head].prevFree = range;
+    }
+    head = range;
+    m_slBitmaps[fl] |= 1u << sl;
+    m_flBitmap |= 1ull << fl;
+    m_freeRangeCount++;
+  }
+
+  void TlsfAllocator::removeFree(uint32_t range) {
+    uint32_t fl;
+    uint32_t sl;
+    mapping(m_ranges[range].size, fl, sl);
+
+    Range &removed = m_ranges[range];
+    if (removed.prevFree != NONE) {
+      m_ranges[removed.prevFree].nextFree = removed.nextFree;
+    } else {
+      m_heads[fl * SL_COUNT + sl] = removed.nextFree;
+    }
+    if (removed.nextFree != NONE) {
+      m_ranges[removed.nextFree].prevFree = removed.prevFree;
+    }
+    if (m_heads[fl * SL_COUNT + sl] == NONE) {
+      m_slBitmaps[fl] &= ~(1u << sl);
+      if (m_slBitmaps[fl] == 0) {
+        m_flBitmap &= ~(1ull << fl);
+      }
+    }
+    removed.free     = false;
+    removed.prevFree = NONE;
+    removed.nextFree = NONE;
+    m_freeRangeCount--;
+  }
+
+  void TlsfAllocator::splitTail(uint32_t range, uint64_t size) {
+    // newRange may grow m_ranges, so everything goes through indices
+    const uint32_t tail         = newRange();
+    m_ranges[tail].offset       = m_ranges[range].offset + size;
+    m_ranges[tail].size         = m_ranges[range].size - size;
+    m_ranges[tail].prevPhysical = range;
+    m_ranges[tail].nextPhysical = m_ranges[range].nextPhysical;
+    if (m_ranges[range].nextPhysical != NONE) {
+      m_ranges[m_ranges[range].nextPhysical].prevPhysical = tail;
+    }
+    m_ranges[range].nextPhysical = tail;
+    m_ranges[range].size         = size;
+    insertFree(tail);
+  }
+
+  MemoryAllocator::MemoryAllocator(VkDevice device,
+                                   const VkPhysicalDeviceMemoryProperties &memoryProperties)
+      : m_device{device}, m_memoryProperties{memoryProperties} {
+    m_blockSizes.resize(m_memoryProperties.memoryTypeCount);
+    m_pools.resize(m_memoryProperties.memoryTypeCount * POOL_KIND_COUNT);
+    for (uint32_t type = 0; type < m_memoryProperties.memoryTypeCount; type++) {
+      // small heaps, like the 256MB host visible window into VRAM, get smaller blocks
+      const VkDeviceSize heapSize =
+          m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[type].heapIndex].size;
+      m_blockSizes[type] = std::min(DEFAULT_BLOCK_SIZE,
+                                    std::bit_floor(std::max<VkDeviceSize>(heapSize / 8, 1 << 20)));
+      for (uint32_t kind = 0; kind < POOL_KIND_COUNT; kind++) {
+        m_pools[type * POOL_KIND_COUNT + kind].memoryType = type;
+      }
+    }
+  }
+
+  MemoryAllocator::~MemoryAllocator() {
+    for (auto &pool : m_pools) {
+      for (uint32_t block = 0; block < pool.blocks.size(); block++) {
+        if (pool.blocks[block] != nullptr) {
+          releaseBlock(pool, block);
+        }
+      }
+    }
+  }
+
+  MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements,
+                                             uint32_t memoryType,
+                                             bool image) {
+    ASSERT_LOG(memoryType < m_memoryProperties.memoryTypeCount,
+               "Memory type {} is out of range",
+               memoryType);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint32_t poolIndex = memoryType * POOL_KIND_COUNT + (image ? IMAGE_POOL : BUFFER_POOL);
+    Pool &pool               = m_pools[poolIndex];
+
+    MemoryAllocation allocation{};
+    allocation.pool = poolIndex;
+    allocation.size = requirements.size;
+
+    uint32_t blockIndex = TlsfAllocator::NONE;
+    uint32_t range      = TlsfAllocator::NONE;
+    for (uint32_t i = 0; i < pool.blocks.size() && range == TlsfAllocator::NONE; i++) {
+      if (pool.blocks[i] != nullptr) {
+        range      = pool.blocks[i]->tlsf->allocate(requirements.size,
+                                               requirements.alignment,
+                                               allocation.offset);
+        blockIndex = i;
+      }
+    }
+    if (range == TlsfAllocator::NONE) {
+      // requests too big to share a block get one of their own
+      const VkDeviceSize blockSize = m_blockSizes[memoryType];
+      blockIndex                   = createBlock(
+          pool,
+          requirements.size > blockSize / 2
+              ? alignUp(requirements.size + requirements.alignment, TlsfAllocator::GRANULARITY)
+              : blockSize);
+      range = pool.blocks[blockIndex]->tlsf->allocate(requirements.size,
+                                                      requirements.alignment,
+                                                      allocation.offset);
+      ASSERT_LOG(range != TlsfAllocator::NONE, "Fresh memory block could not fit the request");
+    }
+    allocation.block = blockIndex;
+    allocation.range = range;
+
+    const Block &block = *pool.blocks[allocation.block];
+    allocation.memory  = block.memory;
+    allocation.mapped  = block.mapped != nullptr ? block.mapped + allocation.offset : nullptr;
+    return allocation;
+  }
+
+  void MemoryAllocator::free(MemoryAllocation &allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Pool &pool   = m_pools[allocation.pool];
+    Block &block = *pool.blocks[allocation.block];
+    block.tlsf->free(allocation.range);
+    // one empty block is kept per pool so alternating create and destroy does not thrash
+    if (block.tlsf->allocationCount() == 0 && liveBlockCount(pool) > 1) {
+      releaseBlock(pool, allocation.block);
+    }
+    allocation = MemoryAllocation{};
+  }
+
+  MemoryStats MemoryAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    MemoryStats stats{};
+    for (const auto &pool : m_pools) {
+      for (const auto &block : pool.blocks) {
+        if (block == nullptr) {
+          continue;
+        }
+        stats.blockCount++;
+        stats.bytesReserved += block->size;
+        stats.allocationCount += block->tlsf->allocationCount();
+        stats.bytesUsed += block->tlsf->usedBytes();
+        stats.freeRangeCount += block->tlsf->freeRangeCount();
+        stats.largestFreeRange = std::max(stats.largestFreeRange, block->tlsf->largestFreeRange());
+      }
+    }
+    return stats;
+  }
+
+  uint32_t MemoryAllocator::createBlock(Pool &pool, VkDeviceSize size) {
+    auto block  = std::make_unique<Block>();
+    block->size = alignUp(size, TlsfAllocator::GRANULARITY);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize  = block->size;
+    allocInfo.memoryTypeIndex = pool.memoryType;
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+      LOG_ERROR("Failed to allocate a {} byte memory block!", block->size);
+      throw std::runtime_error("failed to allocate memory block!");
+    }
+
+    const VkMemoryPropertyFlags flags =
+        m_memoryProperties.memoryTypes[pool.memoryType].propertyFlags;
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+      void *data = nullptr;
+      vkMapMemory(m_device, block->memory, 0, block->size, 0, &data);
+      block->mapped = static_cast<char *>(data);
+    }
+    block->tlsf = std::make_unique<TlsfAllocator>(block->size);
+
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+      if (pool.blocks[i] == nullptr) {
+        pool.blocks[i] = std::move(block);
+        return i;
+      }
+    }
+    pool.blocks.push_back(std::move(block));
+    return static_cast<uint32_t>(pool.blocks.size() - 1);
+  }
+
+  void MemoryAllocator::releaseBlock(Pool &pool, uint32_t block) {
+    if (pool.blocks[block]->mapped != nullptr) {
+      vkUnmapMemory(m_device, pool.blocks[block]->memory);
+    }
+    vkFreeMemory(m_device, pool.blocks[block]->memory, nullptr);
+    pool.blocks[block].reset();
+    // no allocation refers to a null slot, so the ones at the end can go
+    while (!pool.blocks.empty() && pool.blocks.back() == nullptr) {
+      pool.blocks.pop_back();
+    }
+  }
+
+  size_t MemoryAllocator::liveBlockCount(const Pool &pool) const {
+    return std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const auto &block) {
+      return block != nullptr;
+    });
+  }
+} // namespace kopi
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace kopi {
+  // Two-level segregated fit (TLSF) over an abstract range of bytes. Free ranges are kept in one
+  // list per size class, a power of two split into 16 linear steps, and two bitmaps find the first
+  // non-empty class that is large enough, so allocate and free are O(1) and the fit is within
+  // 1/16 of the request. Neighbouring free ranges merge on free.
+  //
+  // Offsets and sizes are multiples of GRANULARITY. Only the bookkeeping lives here, the range
+  // itself may be memory the CPU cannot touch.
+  class TlsfAllocator {
+  public:
+    static constexpr uint64_t GRANULARITY = 256;
+    static constexpr uint32_t NONE        = UINT32_MAX;
+
+    explicit TlsfAllocator(uint64_t size);
+
+    // Returns a handle for free(), or NONE when no free range fits. alignment must be a power of
+    // two.
+    uint32_t allocate(uint64_t size, uint64_t alignment, uint64_t &offset);
+    void free(uint32_t allocation);
+
+    uint64_t size() const { return m_size; }
+    uint64_t usedBytes() const { return m_usedBytes; }
+    size_t allocationCount() const { return m_allocationCount; }
+    size_t freeRangeCount() const { return m_freeRangeCount; }
+    uint64_t largestFreeRange() const;
+
+  private:
+    static constexpr uint32_t SL_BITS  = 4;
+    static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+    static constexpr uint32_t FL_COUNT = 64;
+
+    struct Range {
+      uint64_t offset       = 0;
+      uint64_t size         = 0;
+      uint32_t prevPhysical = NONE;
+      uint32_t nextPhysical = NONE;
+      uint32_t prevFree     = NONE;
+      uint32_t nextFree     = NONE;
+      bool free             = false;
+    };
+
+    static void mapping(uint64_t size, uint32_t &fl, uint32_t &sl);
+    uint32_t newRange();
+    void insertFree(uint32_t range);
+    void removeFree(uint32_t range);
+    // splits the tail past size off range as a new free range
+    void splitTail(uint32_t range, uint64_t size);
+
+    uint64_t m_size;
+    uint64_t m_usedBytes      = 0;
+    size_t m_allocationCount  = 0;
+    size_t m_freeRangeCount   = 0;
+    uint64_t m_flBitmap       = 0;
+    uint32_t m_slBitmaps[FL_COUNT]{};
+    std::vector<uint32_t> m_heads; // FL_COUNT x SL_COUNT free list heads
+    std::vector<Range> m_ranges;
+    std::vector<uint32_t> m_unusedRanges;
+  };
+
+  // Where a resource's memory lives inside one of the allocator's VkDeviceMemory blocks.
+  struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset   = 0;
+    VkDeviceSize size     = 0;
+    // host visible memory only, blocks stay mapped for their whole lifetime
+    void *mapped = nullptr;
+
+    uint32_t pool  = UINT32_MAX;
+    uint32_t block = 0;
+    uint32_t range = 0;
+  };
+
+  struct MemoryStats {
+    size_t blockCount             = 0; // vkAllocateMemory calls currently alive
+    size_t allocationCount        = 0;
+    VkDeviceSize bytesReserved    = 0;
+    VkDeviceSize bytesUsed        = 0;
+    size_t freeRangeCount         = 0;
+    VkDeviceSize largestFreeRange = 0;
+
+    // 0 when all free memory is one range, towards 1 as it splinters into many small ones
+    float fragmentation() const {
+      const VkDeviceSize freeBytes = bytesReserved - bytesUsed;
+      return freeBytes == 0 ? 0.0f
+                            : 1.0f - static_cast<float>(largestFreeRange) /
+                                         static_cast<float>(freeBytes);
+    }
+  };
+
+  // Sub-allocates device memory out of large blocks, so the number of live vkAllocateMemory calls
+  // stays far below maxMemoryAllocationCount. Every memory type has two TLSF pools, one for
+  // buffers and one for optimally tiled images, which keeps linear and non-linear resources out of
+  // each other's bufferImageGranularity pages.
+  class MemoryAllocator {
+  public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull << 20;
+
+    MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties);
+    ~MemoryAllocator();
+
+    MemoryAllocator(const MemoryAllocator &)            = delete;
+    MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+    // image is true for optimally tiled images
+    MemoryAllocation allocate(const VkMemoryRequirements &requirements,
+                              uint32_t memoryType,
+                              bool image);
+    void free(MemoryAllocation &allocation);
+
+    MemoryStats stats() const;
+
+  private:
+    enum PoolKind : uint32_t { BUFFER_POOL, IMAGE_POOL, POOL_KIND_COUNT };
+
+    struct Block {
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+      VkDeviceSize size     = 0;
+      char *mapped          = nullptr;
+      std::unique_ptr<TlsfAllocator> tlsf;
+    };
+
+    struct Pool {
+      uint32_t memoryType = 0;
+      // released blocks leave a null slot so the indices held by allocations stay valid, the next
+      // block created takes it and trailing ones are trimmed
+      std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    uint32_t createBlock(Pool &pool, VkDeviceSize size);
+    void releaseBlock(Pool &pool, uint32_t block);
+    size_t liveBlockCount(const Pool &pool) const;
+
+    VkDevice m_device;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+    std::vector<VkDeviceSize> m_blockSizes; // per memory type, smaller for small heaps
+    std::vector<Pool> m_pools;              // memory type x PoolKind
+    mutable std::mutex m_mutex;
+  };
+} // namespace kopi
@@ -6,40 +6,74 @@
 
 namespace kopi {
 
-  Model::Model(EngineDevice &device, const std::vector<Vertex> &vertices) : m_device(device) {
-    createVertexBuffers(vertices);
+  Model::Model(EngineDevice &device,
+               StagingRing &staging,
+               const std::vector<Vertex> &vertices,
+               const std::vector<uint32_t> &indices)
+      : m_device(device) {
+    createVertexBuffers(staging, vertices);
+    createIndexBuffers(staging, indices);
   }
 
   Model::~Model() {
-    vkDestroyBuffer(m_device.device(), m_vertexBuffer, nullptr);
-    vkFreeMemory(m_device.device(), m_vertexBufferMemory, nullptr);
+    m_device.destroyBuffer(m_vertexBuffer, m_vertexBufferMemory);
+    if (m_indexBuffer != VK_NULL_HANDLE) {
+      m_device.destroyBuffer(m_indexBuffer, m_indexBufferMemory);
+    }
   }
 
   void Model::bind(VkCommandBuffer commandBuffer) {
     VkBuffer buffers[]     = {m_vertexBuffer};
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    if (m_indexCount > 0) {
+      vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    }
   }
 
-  void Model::draw(VkCommandBuffer commandBuffer) {
-    vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+  void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount) {
+    if (m_indexCount > 0) {
+      vkCmdDrawIndexed(commandBuffer, m_indexCount, instanceCount, 0, 0, 0);
+    } else {
+      vkCmdDraw(commandBuffer, m_vertexCount, instanceCount, 0, 0);
+    }
   }
 
-  void Model::createVertexBuffers(const std::vector<Vertex> &vertices) {
+  void Model::createVertexBuffers(StagingRing &staging, const std::vector<Vertex> &vertices) {
     m_vertexCount = static_cast<uint32_t>(vertices.size());
     ASSERT_LOG(m_vertexCount >= 3, "Vertex count must atleast be 3");
     VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
     m_device.createBuffer(bufferSize,
-                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                           m_vertexBuffer,
                           m_vertexBufferMemory);
 
-    void *data;
-    vkMapMemory(m_device.device(), m_vertexBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-    vkUnmapMemory(m_device.device(), m_vertexBufferMemory);
+    m_uploadTicket = staging.upload(m_vertexBuffer,
+                                    0,
+                                    vertices.data(),
+                                    bufferSize,
+                                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+  }
+
+  void Model::createIndexBuffers(StagingRing &staging, const std::vector<uint32_t> &indices) {
+    m_indexCount = static_cast<uint32_t>(indices.size());
+    if (m_indexCount == 0) {
+      return;
+    }
+    ASSERT_LOG(m_indexCount >= 3, "Index count must atleast be 3");
+    VkDeviceSize bufferSize = sizeof(indices[0]) * m_indexCount;
+    m_device.createBuffer(bufferSize,
+                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                          m_indexBuffer,
+                          m_indexBufferMemory);
+
+    m_uploadTicket = staging.upload(m_indexBuffer,
+                                    0,
+                                    indices.data(),
+                                    bufferSize,
+                                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
   }
 
   std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions() {
@@ -66,4 +100,40 @@ namespace kopi {
 
     return attributeDescriptions;
   }
+
+  std::vector<VkVertexInputBindingDescription> Model::InstanceData::getBindingDescriptions() {
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+    bindingDescriptions[0].binding   = 1;
+    bindingDescriptions[0].stride    = sizeof(InstanceData);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindingDescriptions;
+  }
+
+  std::vector<VkVertexInputAttributeDescription> Model::InstanceData::getAttributeDescriptions() {
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(4);
+
+    // a mat2 attribute is fed one column per location
+    attributeDescriptions[0].binding  = 1;
+    attributeDescriptions[0].location = 2;
+    attributeDescriptions[0].format   = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[0].offset   = offsetof(InstanceData, transform);
+
+    attributeDescriptions[1].binding  = 1;
+    attributeDescriptions[1].location = 3;
+    attributeDescriptions[1].format   = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[1].offset   = offsetof(InstanceData, transform) + sizeof(glm::vec2);
+
+    attributeDescriptions[2].binding  = 1;
+    attributeDescriptions[2].location = 4;
+    attributeDescriptions[2].format   = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset   = offsetof(InstanceData, offset);
+
+    attributeDescriptions[3].binding  = 1;
+    attributeDescriptions[3].location = 5;
+    attributeDescriptions[3].format   = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[3].offset   = offsetof(InstanceData, colour);
+
+    return attributeDescriptions;
+  }
 } // namespace kopi
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "EngineDevice.h"
+#include "StagingRing.h"
 #include <vector>
 #include <vulkan/vulkan_core.h>
 #define GLM_FORCE_RADIANS
@@ -17,20 +18,47 @@ namespace kopi {
       static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
     };
 
-    Model(EngineDevice &device, const std::vector<Vertex> &vertices);
+    // Per-object data for instanced draws, stepped once per instance from binding 1 and read from
+    // locations 2 to 5 (the mat2 takes two).
+    struct InstanceData {
+      glm::mat2 transform{1.0f};
+      glm::vec2 offset;
+      glm::vec3 colour;
+
+      static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+      static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+    };
+
+    // Geometry lives in device local memory and is uploaded through staging, so the model can be
+    // drawn once staging has been flushed and the frame waits for it, see uploadTicket. Without
+    // indices the vertices are drawn in order.
+    Model(EngineDevice &device,
+          StagingRing &staging,
+          const std::vector<Vertex> &vertices,
+          const std::vector<uint32_t> &indices = {});
     ~Model();
 
     Model(const Model &)            = delete;
     Model &operator=(const Model &) = delete;
 
     void bind(VkCommandBuffer commandBuffer);
-    void draw(VkCommandBuffer commandBuffer);
+    void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1);
+
+    // completes once both buffers hold the geometry
+    UploadTicket uploadTicket() const { return m_uploadTicket; }
 
   private:
-    void createVertexBuffers(const std::vector<Vertex> &vertices);
+    void createVertexBuffers(StagingRing &staging, const std::vector<Vertex> &vertices);
+    void createIndexBuffers(StagingRing &staging, const std::vector<uint32_t> &indices);
     EngineDevice &m_device;
     VkBuffer m_vertexBuffer;
-    VkDeviceMemory m_vertexBufferMemory;
+    MemoryAllocation m_vertexBufferMemory;
     uint32_t m_vertexCount;
+
+    VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+    MemoryAllocation m_indexBufferMemory;
+    uint32_t m_indexCount = 0;
+
+    UploadTicket m_uploadTicket{};
   };
 } // namespace kopi
\ No newline at end of file
@@ -0,0 +1,388 @@
+#include "NBodyKernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+// ENGINE_SCALAR_KERNELS forces the scalar fallback, so benchmarks can compare it with the SIMD ones
+#if !defined(ENGINE_SCALAR_KERNELS) && (defined(__AVX2__) || defined(__SSE2__))
+#define ENGINE_SIMD_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace kopi {
+  // sources per tile; x, y and mass of a tile take 6KB, which stays resident in L1
+  static constexpr size_t SOURCE_TILE = 512;
+  static constexpr float MIN_DISTANCE_SQUARED = 1e-10f;
+
+  static void accumulateScalar(float targetX,
+                               float targetY,
+                               const float *sourceX,
+                               const float *sourceY,
+                               const float *sourceMass,
+                               size_t begin,
+                               size_t end,
+                               float *accX,
+                               float *accY) {
+    float ax = 0.0f;
+    float ay = 0.0f;
+    for (size_t j = begin; j < end; j++) {
+      float dx              = sourceX[j] - targetX;
+      float dy              = sourceY[j] - targetY;
+      float distanceSquared = dx * dx + dy * dy;
+      if (distanceSquared < MIN_DISTANCE_SQUARED) {
+        continue;
+      }
+      float s = sourceMass[j] / (distanceSquared * std::sqrt(distanceSquared));
+      ax += s * dx;
+      ay += s * dy;
+    }
+    *accX += ax;
+    *accY += ay;
+  }
+
+  static void accumulateFieldScalar(float sampleX,
+                                    float sampleY,
+                                    const float *sourceX,
+                                    const float *sourceY,
+                                    const float *sourceMass,
+                                    size_t begin,
+                                    size_t end,
+                                    float *netX,
+                                    float *netY,
+                                    float *magnitude) {
+    float ax  = 0.0f;
+    float ay  = 0.0f;
+    float sum = 0.0f;
+    for (size_t j = begin; j < end; j++) {
+      float dx              = sourceX[j] - sampleX;
+      float dy              = sourceY[j] - sampleY;
+      float distanceSquared = dx * dx + dy * dy;
+      if (distanceSquared < MIN_DISTANCE_SQUARED) {
+        continue;
+      }
+      float invDistance = 1.0f / std::sqrt(distanceSquared);
+      float s           = sourceMass[j] * invDistance * invDistance;
+      sum += s;
+      ax += s * invDistance * dx;
+      ay += s * invDistance * dy;
+    }
+    *netX += ax;
+    *netY += ay;
+    *magnitude += sum;
+  }
+
+#if defined(ENGINE_SIMD_KERNELS) && defined(__AVX2__) && defined(__FMA__)
+  static constexpr size_t LANES = 8;
+
+  static void accumulateBlock(const float *targetX,
+                              const float *targetY,
+                              const float *sourceX,
+                              const float *sourceY,
+                              const float *sourceMass,
+                              size_t begin,
+                              size_t end,
+                              float *accX,
+                              float *accY) {
+    const __m256 tx        = _mm256_loadu_ps(targetX);
+    const __m256 ty        = _mm256_loadu_ps(targetY);
+    const __m256 minDist   = _mm256_set1_ps(MIN_DISTANCE_SQUARED);
+    const __m256 half      = _mm256_set1_ps(0.5f);
+    const __m256 threeHalf = _mm256_set1_ps(1.5f);
+    __m256 ax              = _mm256_loadu_ps(accX);
+    __m256 ay              = _mm256_loadu_ps(accY);
+
+    for (size_t j = begin; j < end; j++) {
+      __m256 dx = _mm256_sub_ps(_mm256_broadcast_ss(sourceX + j), tx);
+      __m256 dy = _mm256_sub_ps(_mm256_broadcast_ss(sourceY + j), ty);
+      __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+
+      // rsqrt estimate refined with one Newton-Raphson step, ~23 bits
+      __m256 invR = _mm256_rsqrt_ps(r2);
+      invR        = _mm256_mul_ps(invR,
+                           _mm256_fnmadd_ps(_mm256_mul_ps(half, r2),
+                                            _mm256_mul_ps(invR, invR),
+                                            threeHalf));
+      invR = _mm256_and_ps(invR, _mm256_cmp_ps(r2, minDist, _CMP_GE_OQ));
+
+      __m256 s = _mm256_mul_ps(_mm256_broadcast_ss(sourceMass + j),
+                               _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR)));
+      ax       = _mm256_fmadd_ps(s, dx, ax);
+      ay       = _mm256_fmadd_ps(s, dy, ay);
+    }
+
+    _mm256_storeu_ps(accX, ax);
+    _mm256_storeu_ps(accY, ay);
+  }
+
+  static void accumulateFieldBlock(const float *sampleX,
+                                   const float *sampleY,
+                                   const float *sourceX,
+                                   const float *sourceY,
+                                   const float *sourceMass,
+                                   size_t begin,
+                                   size_t end,
+                                   float *netX,
+                                   float *netY,
+                                   float *magnitude) {
+    const __m256 tx        = _mm256_loadu_ps(sampleX);
+    const __m256 ty        = _mm256_loadu_ps(sampleY);
+    const __m256 minDist   = _mm256_set1_ps(MIN_DISTANCE_SQUARED);
+    const __m256 half      = _mm256_set1_ps(0.5f);
+    const __m256 threeHalf = _mm256_set1_ps(1.5f);
+    __m256 ax              = _mm256_loadu_ps(netX);
+    __m256 ay              = _mm256_loadu_ps(netY);
+    __m256 sum             = _mm256_loadu_ps(magnitude);
+
+    for (size_t j = begin; j < end; j++) {
+      __m256 dx = _mm256_sub_ps(_mm256_broadcast_ss(sourceX + j), tx);
+      __m256 dy = _mm256_sub_ps(_mm256_broadcast_ss(sourceY + j), ty);
+      __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+
+      __m256 invR = _mm256_rsqrt_ps(r2);
+      invR        = _mm256_mul_ps(invR,
+                           _mm256_fnmadd_ps(_mm256_mul_ps(half, r2),
+                                            _mm256_mul_ps(invR, invR),
+                                            threeHalf));
+      invR = _mm256_and_ps(invR, _mm256_cmp_ps(r2, minDist, _CMP_GE_OQ));
+
+      // m / r^2 feeds the magnitude sum, one more 1 / r turns it into the vector term
+      __m256 s  = _mm256_mul_ps(_mm256_broadcast_ss(sourceMass + j), _mm256_mul_ps(invR, invR));
+      __m256 sv = _mm256_mul_ps(s, invR);
+      sum       = _mm256_add_ps(sum, s);
+      ax        = _mm256_fmadd_ps(sv, dx, ax);
+      ay        = _mm256_fmadd_ps(sv, dy, ay);
+    }
+
+    _mm256_storeu_ps(netX, ax);
+    _mm256_storeu_ps(netY, ay);
+    _mm256_storeu_ps(magnitude, sum);
+  }
+
+  const char *directSumKernelName() { return "avx2"; }
+#elif defined(ENGINE_SIMD_KERNELS) && defined(__SSE2__)
+  static constexpr size_t LANES = 4;
+
+  static void accumulateBlock(const float *targetX,
+                              const float *targetY,
+                              const float *sourceX,
+                              const float *sourceY,
+                              const float *sourceMass,
+                              size_t begin,
+                              size_t end,
+                              float *accX,
+                              float *accY) {
+    const __m128 tx        = _mm_loadu_ps(targetX);
+    const __m128 ty        = _mm_loadu_ps(targetY);
+    const __m128 minDist   = _mm_set1_ps(MIN_DISTANCE_SQUARED);
+    const __m128 half      = _mm_set1_ps(0.5f);
+    const __m128 threeHalf = _mm_set1_ps(1.5f);
+    __m128 ax              = _mm_loadu_ps(accX);
+    __m128 ay              = _mm_loadu_ps(accY);
+
+    for (size_t j = begin; j < end; j++) {
+      __m128 dx = _mm_sub_ps(_mm_set1_ps(sourceX[j]), tx);
+      __m128 dy = _mm_sub_ps(_mm_set1_ps(sourceY[j]), ty);
+      __m128 r2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+      // rsqrt estimate refined with one Newton-Raphson step, ~23 bits
+      __m128 invR = _mm_rsqrt_ps(r2);
+      invR        = _mm_mul_ps(invR,
+                        _mm_sub_ps(threeHalf,
+                                   _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(invR, invR))));
+      invR        = _mm_and_ps(invR, _mm_cmpge_ps(r2, minDist));
+
+      __m128 s = _mm_mul_ps(_mm_set1_ps(sourceMass[j]),
+                            _mm_mul_ps(invR, _mm_mul_ps(invR, invR)));
+      ax       = _mm_add_ps(ax, _mm_mul_ps(s, dx));
+      ay       = _mm_add_ps(ay, _mm_mul_ps(s, dy));
+    }
+
+    _mm_storeu_ps(accX, ax);
+    _mm_storeu_ps(accY, ay);
+  }
+
+  static void accumulateFieldBlock(const float *sampleX,
+                                   const float *sampleY,
+                                   const float *sourceX,
+                                   const float *sourceY,
+                                   const float *sourceMass,
+                                   size_t begin,
+                                   size_t end,
+                                   float *netX,
+                                   float *netY,
+                                   float *magnitude) {
+    const __m128 tx        = _mm_loadu_ps(sampleX);
+    const __m128 ty        = _mm_loadu_ps(sampleY);
+    const __m128 minDist   = _mm_set1_ps(MIN_DISTANCE_SQUARED);
+    const __m128 half      = _mm_set1_ps(0.5f);
+    const __m128 threeHalf = _mm_set1_ps(1.5f);
+    __m128 ax              = _mm_loadu_ps(netX);
+    __m128 ay              = _mm_loadu_ps(netY);
+    __m128 sum             = _mm_loadu_ps(magnitude);
+
+    for (size_t j = begin; j < end; j++) {
+      __m128 dx = _mm_sub_ps(_mm_set1_ps(sourceX[j]), tx);
+      __m128 dy = _mm_sub_ps(_mm_set1_ps(sourceY[j]), ty);
+      __m128 r2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+      __m128 invR = _mm_rsqrt_ps(r2);
+      invR        = _mm_mul_ps(invR,
+                        _mm_sub_ps(threeHalf,
+                                   _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(invR, invR))));
+      invR        = _mm_and_ps(invR, _mm_cmpge_ps(r2, minDist));
+
+      // m / r^2 feeds the magnitude sum, one more 1 / r turns it into the vector term
+      __m128 s  = _mm_mul_ps(_mm_set1_ps(sourceMass[j]), _mm_mul_ps(invR, invR));
+      __m128 sv = _mm_mul_ps(s, invR);
+      sum       = _mm_add_ps(sum, s);
+      ax        = _mm_add_ps(ax, _mm_mul_ps(sv, dx));
+      ay        = _mm_add_ps(ay, _mm_mul_ps(sv, dy));
+    }
+
+    _mm_storeu_ps(netX, ax);
+    _mm_storeu_ps(netY, ay);
+    _mm_storeu_ps(magnitude, sum);
+  }
+
+  const char *directSumKernelName() { return "sse2"; }
+#else
+  static constexpr size_t LANES = 1;
+
+  static void accumulateBlock(const float *targetX,
+                              const float *targetY,
+                              const float *sourceX,
+                              const float *sourceY,
+                              const float *sourceMass,
+                              size_t begin,
+                              size_t end,
+                              float *accX,
+                              float *accY) {
+    accumulateScalar(*targetX, *targetY, sourceX, sourceY, sourceMass, begin, end, accX, accY);
+  }
+
+  static void accumulateFieldBlock(const float *sampleX,
+                                   const float *sampleY,
+                                   const float *sourceX,
+                                   const float *sourceY,
+                                   const float *sourceMass,
+                                   size_t begin,
+                                   size_t end,
+                                   float *netX,
+                                   float *netY,
+                                   float *magnitude) {
+    accumulateFieldScalar(*sampleX,
+                          *sampleY,
+                          sourceX,
+                          sourceY,
+                          sourceMass,
+                          begin,
+                          end,
+                          netX,
+                          netY,
+                          magnitude);
+  }
+
+  const char *directSumKernelName() { return "scalar"; }
+#endif
+
+  void directSumAccelerations(const float *targetX,
+                              const float *targetY,
+                              size_t targetCount,
+                              const float *sourceX,
+                              const float *sourceY,
+                              const float *sourceMass,
+                              size_t sourceCount,
+                              float strength,
+                              float *accX,
+                              float *accY) {
+    std::fill(accX, accX + targetCount, 0.0f);
+    std::fill(accY, accY + targetCount, 0.0f);
+
+    const size_t vectorCount = targetCount - targetCount % LANES;
+
+    for (size_t tileBegin = 0; tileBegin < sourceCount; tileBegin += SOURCE_TILE) {
+      const size_t tileEnd = std::min(tileBegin + SOURCE_TILE, sourceCount);
+
+      for (size_t i = 0; i < vectorCount; i += LANES) {
+        accumulateBlock(targetX + i,
+                        targetY + i,
+                        sourceX,
+                        sourceY,
+                        sourceMass,
+                        tileBegin,
+                        tileEnd,
+                        accX + i,
+                        accY + i);
+      }
+      for (size_t i = vectorCount; i < targetCount; i++) {
+        accumulateScalar(targetX[i],
+                         targetY[i],
+                         sourceX,
+                         sourceY,
+                         sourceMass,
+                         tileBegin,
+                         tileEnd,
+                         accX + i,
+                         accY + i);
+      }
+    }
+
+    for (size_t i = 0; i < targetCount; i++) {
+      accX[i] *= strength;
+      accY[i] *= strength;
+    }
+  }
+
+  void fieldSamples(const float *sampleX,
+                    const float *sampleY,
+                    size_t sampleCount,
+                    const float *sourceX,
+                    const float *sourceY,
+                    const float *sourceMass,
+                    size_t sourceCount,
+                    float strength,
+                    float *netX,
+                    float *netY,
+                    float *magnitude) {
+    std::fill(netX, netX + sampleCount, 0.0f);
+    std::fill(netY, netY + sampleCount, 0.0f);
+    std::fill(magnitude, magnitude + sampleCount, 0.0f);
+
+    const size_t vectorCount = sampleCount - sampleCount % LANES;
+
+    for (size_t tileBegin = 0; tileBegin < sourceCount; tileBegin += SOURCE_TILE) {
+      const size_t tileEnd = std::min(tileBegin + SOURCE_TILE, sourceCount);
+
+      for (size_t i = 0; i < vectorCount; i += LANES) {
+        accumulateFieldBlock(sampleX + i,
+                             sampleY + i,
+                             sourceX,
+                             sourceY,
+                             sourceMass,
+                             tileBegin,
+                             tileEnd,
+                             netX + i,
+                             netY + i,
+                             magnitude + i);
+      }
+      for (size_t i = vectorCount; i < sampleCount; i++) {
+        accumulateFieldScalar(sampleX[i],
+                              sampleY[i],
+                              sourceX,
+                              sourceY,
+                              sourceMass,
+                              tileBegin,
+                              tileEnd,
+                              netX + i,
+                              netY + i,
+                              magnitude + i);
+      }
+    }
+
+    for (size_t i = 0; i < sampleCount; i++) {
+      netX[i] *= strength;
+      netY[i] *= strength;
+      magnitude[i] *= strength;
+    }
+  }
+} // namespace kopi
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+namespace kopi {
+  // Direct-sum gravitational acceleration of every target from every source, written to accX/accY.
+  // Pairs closer than 1e-10 squared are skipped, so a target that is also a source feels no
+  // self-force. Sources are walked in L1 sized tiles and targets are vectorised with AVX2 or SSE
+  // when the build enables them, falling back to scalar code otherwise.
+  void directSumAccelerations(const float *targetX,
+                              const float *targetY,
+                              size_t targetCount,
+                              const float *sourceX,
+                              const float *sourceY,
+                              const float *sourceMass,
+                              size_t sourceCount,
+                              float strength,
+                              float *accX,
+                              float *accY);
+
+  // Both gravity field terms at each sample point from a single walk over the sources, tiled and
+  // vectorised like directSumAccelerations: the net acceleration sum(G m d / r^3) into netX/netY
+  // and the sum of magnitudes sum(G m / r^2) into magnitude.
+  void fieldSamples(const float *sampleX,
+                    const float *sampleY,
+                    size_t sampleCount,
+                    const float *sourceX,
+                    const float *sourceY,
+                    const float *sourceMass,
+                    size_t sourceCount,
+                    float strength,
+                    float *netX,
+                    float *netY,
+                    float *magnitude);
+
+  // Instruction set the kernels were compiled for: "avx2", "sse2" or "scalar".
+  const char *directSumKernelName();
+} // namespace kopi
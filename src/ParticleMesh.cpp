@@ -0,0 +1,236 @@
+#include "ParticleMesh.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+namespace kopi {
+  static constexpr size_t FFT_ROWS_PER_BLOCK = 16;
+
+  // node index in the padded grid to a signed offset, indices past the midpoint wrap to negative
+  static float wrappedOffset(uint32_t index, uint32_t resolution) {
+    return index < resolution ? static_cast<float>(index)
+                              : static_cast<float>(index) - 2.0f * static_cast<float>(resolution);
+  }
+
+  void ParticleMesh::solve(const float *posX,
+                           const float *posY,
+                           const float *mass,
+                           size_t count,
+                           uint32_t resolution,
+                           float softening,
+                           float strength,
+                           JobSystem *jobs) {
+    ASSERT_LOG(resolution >= 4 && (resolution & (resolution - 1)) == 0,
+               "Particle mesh resolution must be a power of two, got {}",
+               resolution);
+
+    m_strength  = strength;
+    m_totalMass = 0.0f;
+    if (count == 0) {
+      m_accX.clear();
+      m_accY.clear();
+      return;
+    }
+
+    glm::vec2 minPos{posX[0], posY[0]};
+    glm::vec2 maxPos{posX[0], posY[0]};
+    glm::vec2 weighted{};
+    for (size_t i = 0; i < count; i++) {
+      minPos = glm::min(minPos, glm::vec2{posX[i], posY[i]});
+      maxPos = glm::max(maxPos, glm::vec2{posX[i], posY[i]});
+      m_totalMass += mass[i];
+      weighted += mass[i] * glm::vec2{posX[i], posY[i]};
+    }
+    m_centreOfMass = m_totalMass > 0.0f ? weighted / m_totalMass : (minPos + maxPos) * 0.5f;
+
+    // cell size is rounded up to a power of two, so the kernel spectrum only has to be rebuilt
+    // when the scene grows or shrinks by an octave
+    glm::vec2 extent = maxPos - minPos;
+    float span       = std::max({extent.x, extent.y, softening, 1e-4f});
+    float cellSize   = std::exp2(std::ceil(std::log2(span / static_cast<float>(resolution - 2))));
+    float halfWidth  = 0.5f * static_cast<float>(resolution - 1) * cellSize;
+    m_origin         = (minPos + maxPos) * 0.5f - glm::vec2{halfWidth};
+
+    updateKernel(resolution, cellSize, softening, jobs);
+
+    // cloud-in-cell deposit onto the nodes of the unpadded quadrant
+    const uint32_t padded = m_padded;
+    m_density.assign(static_cast<size_t>(padded) * padded, Complex{});
+    for (size_t i = 0; i < count; i++) {
+      float u     = (posX[i] - m_origin.x) / m_cellSize;
+      float v     = (posY[i] - m_origin.y) / m_cellSize;
+      uint32_t i0 = std::min(static_cast<uint32_t>(u), resolution - 2);
+      uint32_t j0 = std::min(static_cast<uint32_t>(v), resolution - 2);
+      float fx    = u - static_cast<float>(i0);
+      float fy    = v - static_cast<float>(j0);
+
+      Complex *row0 = &m_density[static_cast<size_t>(j0) * padded + i0];
+      Complex *row1 = row0 + padded;
+      row0[0] += mass[i] * (1.0f - fx) * (1.0f - fy);
+      row0[1] += mass[i] * fx * (1.0f - fy);
+      row1[0] += mass[i] * (1.0f - fx) * fy;
+      row1[1] += mass[i] * fx * fy;
+    }
+
+    fft2d(m_density, false, jobs);
+    for (size_t k = 0; k < m_density.size(); k++) {
+      m_density[k] *= m_kernelSpectrum[k];
+    }
+    fft2d(m_density, true, jobs);
+
+    const float scale = strength / (static_cast<float>(padded) * static_cast<float>(padded));
+    m_accX.resize(static_cast<size_t>(resolution) * resolution);
+    m_accY.resize(static_cast<size_t>(resolution) * resolution);
+    for (uint32_t j = 0; j < resolution; j++) {
+      for (uint32_t i = 0; i < resolution; i++) {
+        const Complex &value = m_density[static_cast<size_t>(j) * padded + i];
+        size_t node          = static_cast<size_t>(j) * resolution + i;
+        m_accX[node]         = value.real() * scale;
+        m_accY[node]         = value.imag() * scale;
+      }
+    }
+  }
+
+  glm::vec2 ParticleMesh::sampleAcceleration(glm::vec2 position) const {
+    if (!isSolved()) {
+      return {};
+    }
+
+    float u         = (position.x - m_origin.x) / m_cellSize;
+    float v         = (position.y - m_origin.y) / m_cellSize;
+    const float max = static_cast<float>(m_resolution - 1);
+    if (!(u >= 0.0f && v >= 0.0f && u <= max && v <= max)) {
+      glm::vec2 offset      = m_centreOfMass - position;
+      float distanceSquared = glm::dot(offset, offset) + m_softening * m_softening;
+      if (distanceSquared < 1e-10f) {
+        return {};
+      }
+      return m_strength * m_totalMass * offset / (distanceSquared * glm::sqrt(distanceSquared));
+    }
+
+    uint32_t i0 = std::min(static_cast<uint32_t>(u), m_resolution - 2);
+    uint32_t j0 = std::min(static_cast<uint32_t>(v), m_resolution - 2);
+    float fx    = u - static_cast<float>(i0);
+    float fy    = v - static_cast<float>(j0);
+    size_t k    = static_cast<size_t>(j0) * m_resolution + i0;
+
+    auto bilinear = [&](const std::vector<float> &grid) {
+      return (1.0f - fy) * ((1.0f - fx) * grid[k] + fx * grid[k + 1]) +
+             fy * ((1.0f - fx) * grid[k + m_resolution] + fx * grid[k + m_resolution + 1]);
+    };
+    return {bilinear(m_accX), bilinear(m_accY)};
+  }
+
+  void ParticleMesh::updateKernel(uint32_t resolution,
+                                  float cellSize,
+                                  float softening,
+                                  JobSystem *jobs) {
+    if (resolution == m_resolution && cellSize == m_cellSize && softening == m_softening) {
+      return;
+    }
+
+    if (resolution != m_resolution) {
+      m_resolution = resolution;
+      m_padded     = 2 * resolution;
+
+      uint32_t bits = 0;
+      while ((1u << bits) < m_padded) {
+        bits++;
+      }
+      m_bitReverse.resize(m_padded);
+      for (uint32_t i = 0; i < m_padded; i++) {
+        uint32_t reversed = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+          reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+        }
+        m_bitReverse[i] = reversed;
+      }
+
+      m_twiddles.resize(m_padded / 2);
+      for (uint32_t k = 0; k < m_padded / 2; k++) {
+        float angle = -glm::two_pi<float>() * static_cast<float>(k) / static_cast<float>(m_padded);
+        m_twiddles[k] = {std::cos(angle), std::sin(angle)};
+      }
+    }
+    m_cellSize  = cellSize;
+    m_softening = softening;
+
+    // acceleration of a unit mass at the origin felt at a node offset (dx, dy) away, with the
+    // negative offsets wrapped into the upper half of the padded grid
+    const uint32_t padded = m_padded;
+    const float soft2     = softening * softening;
+    m_kernelSpectrum.assign(static_cast<size_t>(padded) * padded, Complex{});
+    for (uint32_t j = 0; j < padded; j++) {
+      for (uint32_t i = 0; i < padded; i++) {
+        if (i == resolution || j == resolution) {
+          continue;
+        }
+        float dx              = wrappedOffset(i, resolution) * cellSize;
+        float dy              = wrappedOffset(j, resolution) * cellSize;
+        float distanceSquared = dx * dx + dy * dy + soft2;
+        if (distanceSquared < 1e-20f) {
+          continue;
+        }
+        float inv = 1.0f / (distanceSquared * std::sqrt(distanceSquared));
+        m_kernelSpectrum[static_cast<size_t>(j) * padded + i] = {-dx * inv, -dy * inv};
+      }
+    }
+    fft2d(m_kernelSpectrum, false, jobs);
+  }
+
+  // Row FFTs, transpose, row FFTs. A forward transform leaves the spectrum transposed, which is
+  // fine since spectra are only multiplied with each other, and the inverse transposes it back.
+  void ParticleMesh::fft2d(std::vector<Complex> &data, bool inverse, JobSystem *jobs) {
+    const uint32_t padded = m_padded;
+    auto rows             = [&](size_t begin, size_t end) {
+      for (size_t row = begin; row < end; row++) {
+        fft1d(&data[row * padded], inverse);
+      }
+    };
+    auto transformRows = [&]() {
+      if (jobs != nullptr) {
+        jobs->parallelFor(padded, FFT_ROWS_PER_BLOCK, rows);
+        return;
+      }
+      rows(0, padded);
+    };
+
+    transformRows();
+    for (uint32_t j = 0; j < padded; j++) {
+      for (uint32_t i = j + 1; i < padded; i++) {
+        std::swap(data[static_cast<size_t>(j) * padded + i],
+                  data[static_cast<size_t>(i) * padded + j]);
+      }
+    }
+    transformRows();
+  }
+
+  void ParticleMesh::fft1d(Complex *data, bool inverse) const {
+    const uint32_t n = m_padded;
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t j = m_bitReverse[i];
+      if (i < j) {
+        std::swap(data[i], data[j]);
+      }
+    }
+
+    for (uint32_t length = 2; length <= n; length <<= 1) {
+      const uint32_t half = length / 2;
+      const uint32_t step = n / length;
+      for (uint32_t start = 0; start < n; start += length) {
+        for (uint32_t k = 0; k < half; k++) {
+          Complex w = m_twiddles[k * step];
+          if (inverse) {
+            w = std::conj(w);
+          }
+          Complex even           = data[start + k];
+          Complex odd            = data[start + k + half] * w;
+          data[start + k]        = even + odd;
+          data[start + k + half] = even - odd;
+        }
+      }
+    }
+  }
+} // namespace kopi
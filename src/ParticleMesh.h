@@ -0,0 +1,68 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace kopi {
+  // Particle-mesh gravity. Mass is deposited onto a square grid with cloud-in-cell weights and the
+  // acceleration field is found by convolving it with the softened point mass kernel in Fourier
+  // space, so a solve costs O(bodies + cells log cells) instead of O(bodies^2).
+  //
+  // The grid is zero padded to twice its size, which keeps boundaries isolated (no periodic
+  // images). Forces are accurate down to a couple of cells, below that they are smoothed out.
+  class ParticleMesh {
+  public:
+    // resolution is the number of grid nodes per side and must be a power of two, softening is
+    // the Plummer length in world units. jobs is optional.
+    void solve(const float *posX,
+               const float *posY,
+               const float *mass,
+               size_t count,
+               uint32_t resolution,
+               float softening,
+               float strength,
+               JobSystem *jobs  = nullptr);
+
+    // CIC interpolated acceleration at any point. Outside the grid the bodies are treated as a
+    // single mass at their centre of mass.
+    glm::vec2 sampleAcceleration(glm::vec2 position) const;
+
+    bool isSolved() const { return !m_accX.empty(); }
+    uint32_t resolution() const { return m_resolution; }
+    float cellSize() const { return m_cellSize; }
+    glm::vec2 origin() const { return m_origin; }
+
+  private:
+    using Complex = std::complex<float>;
+
+    void updateKernel(uint32_t resolution, float cellSize, float softening, JobSystem *jobs);
+    void fft2d(std::vector<Complex> &data, bool inverse, JobSystem *jobs);
+    void fft1d(Complex *data, bool inverse) const;
+
+    uint32_t m_resolution = 0;
+    uint32_t m_padded     = 0; // FFT size, 2 * m_resolution
+    float m_cellSize      = 0.0f;
+    float m_softening     = -1.0f;
+    float m_strength      = 0.0f;
+    glm::vec2 m_origin{};
+
+    float m_totalMass = 0.0f;
+    glm::vec2 m_centreOfMass{};
+
+    std::vector<uint32_t> m_bitReverse;
+    std::vector<Complex> m_twiddles;
+    // spectrum of kernelX + i * kernelY, so one inverse FFT yields both force components
+    std::vector<Complex> m_kernelSpectrum;
+    std::vector<Complex> m_density;
+
+    std::vector<float> m_accX; // resolution x resolution node values, row major in y
+    std::vector<float> m_accY;
+  };
+} // namespace kopi
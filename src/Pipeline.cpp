@@ -3,14 +3,48 @@
 #include "Log.h"
 #include "Model.h"
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
-#include <fstream>
-#include <ios>
+#include <cstring>
 #include <stdexcept>
 #include <vulkan/vulkan_core.h>
 
 namespace kopi {
+  VkSpecializationInfo SpecializationConstants::info() const {
+    VkSpecializationInfo info{};
+    info.mapEntryCount = static_cast<uint32_t>(m_entries.size());
+    info.pMapEntries   = m_entries.data();
+    info.dataSize      = m_data.size();
+    info.pData         = m_data.data();
+    return info;
+  }
+
+  SpecializationConstants &SpecializationConstants::setBytes(uint32_t constantId,
+                                                             const void *value,
+                                                             size_t size) {
+    auto entry = m_entries.begin();
+    while (entry != m_entries.end() && entry->constantID < constantId) {
+      entry++;
+    }
+    if (entry != m_entries.end() && entry->constantID == constantId) {
+      ASSERT_LOG(entry->size == size,
+                 "Specialization constant {} set with {} bytes, was {}",
+                 constantId,
+                 size,
+                 entry->size);
+      memcpy(m_data.data() + entry->offset, value, size);
+      return *this;
+    }
+
+    // values sit at a multiple of their size, like they would in a struct
+    const size_t offset = (m_data.size() + size - 1) / size * size;
+    m_data.resize(offset + size);
+    memcpy(m_data.data() + offset, value, size);
+    m_entries.insert(entry, {constantId, static_cast<uint32_t>(offset), size});
+    return *this;
+  }
+
   Pipeline::Pipeline(EngineDevice &device,
                      const std::string &vertFilePath,
                      const std::string &fragFilePath,
@@ -19,14 +53,21 @@ namespace kopi {
     createGraphicsPipeline(vertFilePath, fragFilePath, configInfo);
   }
 
+  Pipeline::Pipeline(EngineDevice &device,
+                     const std::string &compFilePath,
+                     VkPipelineLayout pipelineLayout,
+                     const SpecializationConstants &specialization)
+      : m_device(device), m_bindPoint(VK_PIPELINE_BIND_POINT_COMPUTE) {
+    createComputePipeline(compFilePath, pipelineLayout, specialization);
+  }
+
   Pipeline::~Pipeline() {
-    vkDestroyShaderModule(m_device.device(), m_vertShaderModule, nullptr);
-    vkDestroyShaderModule(m_device.device(), m_fragShaderModule, nullptr);
-    vkDestroyPipeline(m_device.device(), m_graphicsPipeline, nullptr);
+    // the shader modules belong to the device's ShaderModuleCache
+    vkDestroyPipeline(m_device.device(), m_pipeline, nullptr);
   }
 
   void Pipeline::bind(VkCommandBuffer commandBuffer) {
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+    vkCmdBindPipeline(commandBuffer, m_bindPoint, m_pipeline);
   }
 
   void Pipeline::createGraphicsPipeline(const std::string &vertFilePath,
@@ -39,36 +80,35 @@ namespace kopi {
     ASSERT_LOG(configInfo.renderPass != VK_NULL_HANDLE,
                "Cannot create graphics pipeline; No renderPass in configInfo");
 
-    auto vertCode = readFile(vertFilePath);
-    auto fragCode = readFile(fragFilePath);
+    VkShaderModule vertShaderModule = m_device.shaderModules().load(vertFilePath);
+    VkShaderModule fragShaderModule = m_device.shaderModules().load(fragFilePath);
 
-    LOG_DEBUG("Vertex Shader code size: {}", vertCode.size());
-    LOG_DEBUG("Fragment Shader code size: {}", fragCode.size());
-
-    createShaderModule(vertCode, &m_vertShaderModule);
-    createShaderModule(fragCode, &m_fragShaderModule);
+    const VkSpecializationInfo vertSpecialization = configInfo.vertSpecialization.info();
+    const VkSpecializationInfo fragSpecialization = configInfo.fragSpecialization.info();
 
     VkPipelineShaderStageCreateInfo shaderStages[2];
     shaderStages[0].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[0].stage  = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = m_vertShaderModule;
+    shaderStages[0].module = vertShaderModule;
     shaderStages[0].pName  = "main";
     shaderStages[0].flags  = 0;
     shaderStages[0].pNext  = nullptr;
 
-    shaderStages[0].pSpecializationInfo = nullptr;
+    shaderStages[0].pSpecializationInfo =
+        configInfo.vertSpecialization.empty() ? nullptr : &vertSpecialization;
 
     shaderStages[1].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[1].stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = m_fragShaderModule;
+    shaderStages[1].module = fragShaderModule;
     shaderStages[1].pName  = "main";
     shaderStages[1].flags  = 0;
     shaderStages[1].pNext  = nullptr;
 
-    shaderStages[1].pSpecializationInfo = nullptr;
+    shaderStages[1].pSpecializationInfo =
+        configInfo.fragSpecialization.empty() ? nullptr : &fragSpecialization;
 
-    auto bindingDescriptions   = Model::Vertex::getBindingDescriptions();
-    auto attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+    auto &bindingDescriptions   = configInfo.bindingDescriptions;
+    auto &attributeDescriptions = configInfo.attributeDescriptions;
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -99,50 +139,59 @@ namespace kopi {
     pipeLineInfo.basePipelineIndex  = -1;
     pipeLineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+    // compiling is most of startup on a cold pipeline cache, the time shows whether it was warm
+    const auto start = std::chrono::steady_clock::now();
     if (vkCreateGraphicsPipelines(m_device.device(),
-                                  VK_NULL_HANDLE,
+                                  m_device.pipelineCache(),
                                   1,
                                   &pipeLineInfo,
                                   nullptr,
-                                  &m_graphicsPipeline) != VK_SUCCESS) {
+                                  &m_pipeline) != VK_SUCCESS) {
       LOG_ERROR("Failed to create Graphics Pipeline!");
       throw std::runtime_error("Failed to create Graphics Pipeline!");
     }
+    LOG_INFO("Created graphics pipeline {} in {:.2f} ms",
+             vertFilePath,
+             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                 .count());
   }
 
-  void Pipeline::createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule) {
-    VkShaderModuleCreateInfo createInfo{}; // common pattern with vulkan
-    createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode    = reinterpret_cast<const uint32_t *>(code.data());
-    // weird ass alignment??? from char to uint32
-    // apparently bypasses this weirdness since the vextor allocates for worst case scenario
-    // already?
-
-    if (vkCreateShaderModule(m_device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-      LOG_ERROR("Failed to create shader module!");
-      throw std::runtime_error("Failed to create shader module!");
-    }
-  }
-
-  std::vector<char> Pipeline::readFile(const std::string &filePath) {
-    LOG_DEBUG("filepath: {}", filePath);
-    std::fstream file(filePath, std::ios::in | std::ios::ate | std::ios::binary);
-
-    if (!file.is_open()) {
-      LOG_ERROR("failed to open file {}", filePath.data());
-      throw std::runtime_error("failed to open file");
+  void Pipeline::createComputePipeline(const std::string &compFilePath,
+                                       VkPipelineLayout pipelineLayout,
+                                       const SpecializationConstants &specialization) {
+    ASSERT_LOG(pipelineLayout != VK_NULL_HANDLE,
+               "Cannot create compute pipeline; No pipelineLayout given");
+
+    const VkSpecializationInfo specializationInfo = specialization.info();
+
+    VkPipelineShaderStageCreateInfo shaderStage{};
+    shaderStage.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStage.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStage.module              = m_device.shaderModules().load(compFilePath);
+    shaderStage.pName               = "main";
+    shaderStage.pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage              = shaderStage;
+    pipelineInfo.layout             = pipelineLayout;
+    pipelineInfo.basePipelineIndex  = -1;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    const auto start = std::chrono::steady_clock::now();
+    if (vkCreateComputePipelines(m_device.device(),
+                                 m_device.pipelineCache(),
+                                 1,
+                                 &pipelineInfo,
+                                 nullptr,
+                                 &m_pipeline) != VK_SUCCESS) {
+      LOG_ERROR("Failed to create Compute Pipeline!");
+      throw std::runtime_error("Failed to create Compute Pipeline!");
     }
-
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), (std::streamsize)fileSize);
-
-    file.close();
-
-    return buffer;
+    LOG_INFO("Created compute pipeline {} in {:.2f} ms",
+             compFilePath,
+             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                 .count());
   }
 
   void Pipeline::defaultPipelineConfigInfo(PipelineConfigInfo &configInfo) {
@@ -222,6 +271,10 @@ namespace kopi {
     configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
     configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
     configInfo.dynamicStateInfo.pNext = 0;
+
+    // ---Vertex Input---
+    configInfo.bindingDescriptions   = Model::Vertex::getBindingDescriptions();
+    configInfo.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
   }
 
 } // namespace kopi
\ No newline at end of file
@@ -1,11 +1,48 @@
 #pragma once
 
 #include "EngineDevice.h"
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace kopi {
+  // Values for one shader stage's specialization constants, by constant_id. The driver folds them
+  // into the shader when the pipeline is compiled, so a branch on one costs nothing at runtime
+  // and variants need no separate GLSL. Part of the pipeline's identity in PipelineLibrary.
+  class SpecializationConstants {
+  public:
+    // bool goes in as a VkBool32, as Vulkan expects for a GLSL bool constant.
+    template <typename T> SpecializationConstants &set(uint32_t constantId, T value) {
+      static_assert(std::is_same_v<T, bool> || std::is_same_v<T, int32_t> ||
+                        std::is_same_v<T, uint32_t> || std::is_same_v<T, float> ||
+                        std::is_same_v<T, int64_t> || std::is_same_v<T, uint64_t> ||
+                        std::is_same_v<T, double>,
+                    "specialization constants are bool, 32 or 64 bit integers or float/double");
+      if constexpr (std::is_same_v<T, bool>) {
+        const VkBool32 boolValue = value ? VK_TRUE : VK_FALSE;
+        return setBytes(constantId, &boolValue, sizeof(boolValue));
+      } else {
+        return setBytes(constantId, &value, sizeof(value));
+      }
+    }
+
+    bool empty() const { return m_entries.empty(); }
+    // sorted by constantID, whatever order set was called in
+    const std::vector<VkSpecializationMapEntry> &entries() const { return m_entries; }
+    const std::vector<char> &data() const { return m_data; }
+
+    // Points into this object, which has to outlive its use.
+    VkSpecializationInfo info() const;
+
+  private:
+    SpecializationConstants &setBytes(uint32_t constantId, const void *value, size_t size);
+
+    std::vector<VkSpecializationMapEntry> m_entries;
+    std::vector<char> m_data;
+  };
+
   struct PipelineConfigInfo {
     PipelineConfigInfo() = default;
 
@@ -21,9 +58,13 @@ namespace kopi {
     VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
     std::vector<VkDynamicState> dynamicStateEnables;
     VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
     VkPipelineLayout pipelineLayout = nullptr;
     VkRenderPass renderPass         = nullptr;
     uint32_t subpass                = 0;
+    SpecializationConstants vertSpecialization;
+    SpecializationConstants fragSpecialization;
   };
   class Pipeline {
   public:
@@ -31,6 +72,10 @@ namespace kopi {
              const std::string &vertFilePath,
              const std::string &fragFilePath,
              const PipelineConfigInfo &configInfo);
+    Pipeline(EngineDevice &device,
+             const std::string &compFilePath,
+             VkPipelineLayout pipelineLayout,
+             const SpecializationConstants &specialization = {});
 
     ~Pipeline();
     Pipeline() = default;
@@ -43,17 +88,16 @@ namespace kopi {
     static void defaultPipelineConfigInfo(PipelineConfigInfo &configInfo);
 
   private:
-    static std::vector<char> readFile(const std::string &filePath);
-
     void createGraphicsPipeline(const std::string &vertFilePath,
                                 const std::string &fragFilePath,
                                 const PipelineConfigInfo &configInfo);
 
-    void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule);
+    void createComputePipeline(const std::string &compFilePath,
+                               VkPipelineLayout pipelineLayout,
+                               const SpecializationConstants &specialization);
 
     EngineDevice &m_device;
-    VkPipeline m_graphicsPipeline;
-    VkShaderModule m_vertShaderModule;
-    VkShaderModule m_fragShaderModule;
+    VkPipeline m_pipeline;
+    VkPipelineBindPoint m_bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
   };
 } // namespace kopi
@@ -0,0 +1,352 @@
+#include "PipelineLibrary.h"
+#include "Hash.h"
+#include "Log.h"
+
+#include <exception>
+#include <stdexcept>
+
+namespace kopi {
+  // The create infos point into the config itself, the copy has to point into the copy.
+  static void copyPipelineConfigInfo(const PipelineConfigInfo &src, PipelineConfigInfo &dst) {
+    dst.viewportInfo          = src.viewportInfo;
+    dst.inputAssemblyInfo     = src.inputAssemblyInfo;
+    dst.rasterizationInfo     = src.rasterizationInfo;
+    dst.multisampleInfo       = src.multisampleInfo;
+    dst.colorBlendAttachment  = src.colorBlendAttachment;
+    dst.colorBlendInfo        = src.colorBlendInfo;
+    dst.depthStencilInfo      = src.depthStencilInfo;
+    dst.dynamicStateEnables   = src.dynamicStateEnables;
+    dst.dynamicStateInfo      = src.dynamicStateInfo;
+    dst.bindingDescriptions   = src.bindingDescriptions;
+    dst.attributeDescriptions = src.attributeDescriptions;
+    dst.pipelineLayout        = src.pipelineLayout;
+    dst.renderPass            = src.renderPass;
+    dst.subpass               = src.subpass;
+    dst.vertSpecialization    = src.vertSpecialization;
+    dst.fragSpecialization    = src.fragSpecialization;
+
+    dst.colorBlendInfo.pAttachments =
+        src.colorBlendInfo.pAttachments != nullptr ? &dst.colorBlendAttachment : nullptr;
+    dst.dynamicStateInfo.pDynamicStates = dst.dynamicStateEnables.data();
+  }
+
+  static void hashStencilOpState(Hasher &hasher, const VkStencilOpState &state) {
+    hasher.add(state.failOp).add(state.passOp).add(state.depthFailOp).add(state.compareOp);
+    hasher.add(state.compareMask).add(state.writeMask).add(state.reference);
+  }
+
+  // By constant, the value bytes but not where they sit in the data.
+  static void hashSpecializationConstants(Hasher &hasher,
+                                          const SpecializationConstants &constants) {
+    hasher.add(constants.entries().size());
+    for (const auto &entry : constants.entries()) {
+      hasher.add(entry.constantID).add(entry.size);
+      hasher.bytes(constants.data().data() + entry.offset, entry.size);
+    }
+  }
+
+  // Everything Pipeline::createGraphicsPipeline reads from the config. Pointers into the config
+  // and sTypes are left out, viewports and scissors are dynamic.
+  static void hashPipelineConfigInfo(Hasher &hasher, const PipelineConfigInfo &config) {
+    const auto &inputAssembly = config.inputAssemblyInfo;
+    hasher.add(inputAssembly.topology).add(inputAssembly.primitiveRestartEnable);
+
+    const auto &raster = config.rasterizationInfo;
+    hasher.add(raster.depthClampEnable).add(raster.rasterizerDiscardEnable);
+    hasher.add(raster.polygonMode).add(raster.cullMode).add(raster.frontFace);
+    hasher.add(raster.depthBiasEnable).add(raster.depthBiasConstantFactor);
+    hasher.add(raster.depthBiasClamp).add(raster.depthBiasSlopeFactor).add(raster.lineWidth);
+
+    const auto &multisample = config.multisampleInfo;
+    hasher.add(multisample.rasterizationSamples).add(multisample.sampleShadingEnable);
+    hasher.add(multisample.minSampleShading).add(multisample.alphaToCoverageEnable);
+    hasher.add(multisample.alphaToOneEnable);
+
+    const auto &blend = config.colorBlendInfo;
+    hasher.add(blend.logicOpEnable).add(blend.logicOp).add(blend.attachmentCount);
+    for (float constant : blend.blendConstants) {
+      hasher.add(constant);
+    }
+    const auto &attachment = config.colorBlendAttachment;
+    hasher.add(attachment.blendEnable).add(attachment.colorWriteMask);
+    hasher.add(attachment.srcColorBlendFactor).add(attachment.dstColorBlendFactor);
+    hasher.add(attachment.colorBlendOp).add(attachment.srcAlphaBlendFactor);
+    hasher.add(attachment.dstAlphaBlendFactor).add(attachment.alphaBlendOp);
+
+    const auto &depth = config.depthStencilInfo;
+    hasher.add(depth.depthTestEnable).add(depth.depthWriteEnable).add(depth.depthCompareOp);
+    hasher.add(depth.depthBoundsTestEnable).add(depth.minDepthBounds).add(depth.maxDepthBounds);
+    hasher.add(depth.stencilTestEnable);
+    hashStencilOpState(hasher, depth.front);
+    hashStencilOpState(hasher, depth.back);
+
+    hasher.add(config.dynamicStateEnables.size());
+    for (VkDynamicState state : config.dynamicStateEnables) {
+      hasher.add(state);
+    }
+    hasher.add(config.bindingDescriptions.size());
+    for (const auto &binding : config.bindingDescriptions) {
+      hasher.add(binding.binding).add(binding.stride).add(binding.inputRate);
+    }
+    hasher.add(config.attributeDescriptions.size());
+    for (const auto &attribute : config.attributeDescriptions) {
+      hasher.add(attribute.location).add(attribute.binding).add(attribute.format);
+      hasher.add(attribute.offset);
+    }
+
+    // the layout is one of the library's, its handle stands for its contents
+    hasher.add(config.pipelineLayout).add(config.renderPass).add(config.subpass);
+    hashSpecializationConstants(hasher, config.vertSpecialization);
+    hashSpecializationConstants(hasher, config.fragSpecialization);
+  }
+
+  PipelineLibrary::PipelineLibrary(EngineDevice &device, unsigned int threadCount)
+      : m_device{device} {
+    m_threads.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++) {
+      m_threads.emplace_back([this] { compileLoop(); });
+    }
+  }
+
+  PipelineLibrary::~PipelineLibrary() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+      m_queue.clear();
+    }
+    m_wake.notify_all();
+    for (auto &thread : m_threads) {
+      thread.join();
+    }
+
+    // nothing compiles any more, pipelines already built do not need their layouts
+    for (auto &[key, layout] : m_pipelineLayouts) {
+      vkDestroyPipelineLayout(m_device.device(), layout, nullptr);
+    }
+    for (auto &[key, layout] : m_descriptorSetLayouts) {
+      vkDestroyDescriptorSetLayout(m_device.device(), layout, nullptr);
+    }
+  }
+
+  VkDescriptorSetLayout PipelineLibrary::descriptorSetLayout(
+      const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+    Hasher hasher;
+    hasher.add(bindings.size());
+    for (const auto &binding : bindings) {
+      ASSERT_LOG(binding.pImmutableSamplers == nullptr,
+                 "Binding {} has immutable samplers, which layouts do not support",
+                 binding.binding);
+      hasher.add(binding.binding).add(binding.descriptorType).add(binding.descriptorCount);
+      hasher.add(binding.stageFlags);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_descriptorSetLayouts.find(hasher.value());
+    if (found != m_descriptorSetLayouts.end()) {
+      return found->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings    = bindings.data();
+
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(m_device.device(), &layoutInfo, nullptr, &layout) !=
+        VK_SUCCESS) {
+      LOG_ERROR("Failed to create descriptor set layout!");
+      throw std::runtime_error("Failed to create descriptor set layout!");
+    }
+    m_descriptorSetLayouts.emplace(hasher.value(), layout);
+    return layout;
+  }
+
+  VkPipelineLayout PipelineLibrary::pipelineLayout(
+      const std::vector<VkDescriptorSetLayout> &setLayouts,
+      const std::vector<VkPushConstantRange> &pushConstantRanges) {
+    // set layouts are deduplicated too, so equal handles mean equal contents
+    Hasher hasher;
+    hasher.add(setLayouts.size());
+    for (VkDescriptorSetLayout setLayout : setLayouts) {
+      hasher.add(setLayout);
+    }
+    hasher.add(pushConstantRanges.size());
+    for (const auto &range : pushConstantRanges) {
+      hasher.add(range.stageFlags).add(range.offset).add(range.size);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (VkDescriptorSetLayout setLayout : setLayouts) {
+      ASSERT_LOG(std::any_of(m_descriptorSetLayouts.begin(),
+                             m_descriptorSetLayouts.end(),
+                             [&](const auto &owned) { return owned.second == setLayout; }),
+                 "Descriptor set layout was not created by the pipeline library");
+    }
+    auto found = m_pipelineLayouts.find(hasher.value());
+    if (found != m_pipelineLayouts.end()) {
+      return found->second;
+    }
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount         = static_cast<uint32_t>(setLayouts.size());
+    layoutInfo.pSetLayouts            = setLayouts.data();
+    layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    layoutInfo.pPushConstantRanges    = pushConstantRanges.data();
+
+    VkPipelineLayout layout;
+    if (vkCreatePipelineLayout(m_device.device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+      LOG_ERROR("Failed to create pipeline layout!");
+      throw std::runtime_error("Failed to create pipeline layout!");
+    }
+    m_pipelineLayouts.emplace(hasher.value(), layout);
+    return layout;
+  }
+
+  PipelineHandle PipelineLibrary::graphics(const std::string &vertFilePath,
+                                           const std::string &fragFilePath,
+                                           const PipelineConfigInfo &configInfo) {
+    ASSERT_LOG(ownsPipelineLayout(configInfo.pipelineLayout),
+               "Pipeline layout was not created by the pipeline library");
+    Hasher hasher;
+    hasher.add(std::string_view{"graphics"}).add(vertFilePath).add(fragFilePath);
+    hashPipelineConfigInfo(hasher, configInfo);
+
+    auto config = std::make_shared<PipelineConfigInfo>();
+    copyPipelineConfigInfo(configInfo, *config);
+    return request(hasher.value(), [this, vertFilePath, fragFilePath, config] {
+      return std::make_unique<Pipeline>(m_device, vertFilePath, fragFilePath, *config);
+    });
+  }
+
+  PipelineHandle PipelineLibrary::compute(const std::string &compFilePath,
+                                          VkPipelineLayout pipelineLayout,
+                                          const SpecializationConstants &specialization) {
+    ASSERT_LOG(ownsPipelineLayout(pipelineLayout),
+               "Pipeline layout was not created by the pipeline library");
+    Hasher hasher;
+    hasher.add(std::string_view{"compute"}).add(compFilePath).add(pipelineLayout);
+    hashSpecializationConstants(hasher, specialization);
+    return request(hasher.value(), [this, compFilePath, pipelineLayout, specialization] {
+      return std::make_unique<Pipeline>(m_device, compFilePath, pipelineLayout, specialization);
+    });
+  }
+
+  PipelineHandle PipelineLibrary::request(uint64_t key,
+                                          std::function<std::unique_ptr<Pipeline>()> build) {
+    std::shared_ptr<PipelineEntry> entry;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto found = m_entries.find(key);
+      if (found != m_entries.end()) {
+        return PipelineHandle{found->second};
+      }
+      entry        = std::make_shared<PipelineEntry>();
+      entry->key   = key;
+      entry->build = std::move(build);
+      m_entries.emplace(key, entry);
+      if (!m_threads.empty()) {
+        m_queue.push_back(entry);
+      }
+    }
+
+    if (m_threads.empty()) {
+      compile(*entry);
+    } else {
+      m_wake.notify_one();
+    }
+    return PipelineHandle{entry};
+  }
+
+  void PipelineLibrary::wait(const PipelineHandle &handle) {
+    if (!handle.m_entry) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto queued = std::find(m_queue.begin(), m_queue.end(), handle.m_entry);
+    if (queued != m_queue.end()) {
+      // nobody has started on it, the compile threads may be busy for a while yet
+      m_queue.erase(queued);
+      m_compiling++;
+      lock.unlock();
+      compile(*handle.m_entry);
+      lock.lock();
+      m_compiling--;
+      m_compiled.notify_all();
+      return;
+    }
+    m_compiled.wait(lock, [&] {
+      return handle.m_entry->state.load(std::memory_order_acquire) !=
+             PipelineEntry::State::Pending;
+    });
+  }
+
+  void PipelineLibrary::waitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // helps with the queue instead of sitting idle next to it
+    while (!m_queue.empty()) {
+      auto entry = std::move(m_queue.front());
+      m_queue.pop_front();
+      m_compiling++;
+      lock.unlock();
+      compile(*entry);
+      lock.lock();
+      m_compiling--;
+    }
+    m_compiled.notify_all();
+    m_compiled.wait(lock, [&] { return m_compiling == 0; });
+  }
+
+  size_t PipelineLibrary::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+  size_t PipelineLibrary::pendingCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size() + m_compiling;
+  }
+
+  void PipelineLibrary::compileLoop() {
+    for (;;) {
+      std::shared_ptr<PipelineEntry> entry;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [&] { return m_stop || !m_queue.empty(); });
+        if (m_stop) {
+          return;
+        }
+        entry = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_compiling++;
+      }
+
+      compile(*entry);
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_compiling--;
+      }
+      m_compiled.notify_all();
+    }
+  }
+
+  bool PipelineLibrary::ownsPipelineLayout(VkPipelineLayout layout) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::any_of(m_pipelineLayouts.begin(), m_pipelineLayouts.end(), [&](const auto &owned) {
+      return owned.second == layout;
+    });
+  }
+
+  void PipelineLibrary::compile(PipelineEntry &entry) {
+    PipelineEntry::State state = PipelineEntry::State::Ready;
+    try {
+      entry.pipeline = entry.build();
+    } catch (const std::exception &error) {
+      LOG_ERROR("Pipeline {:016x} failed to compile: {}", entry.key, error.what());
+      state = PipelineEntry::State::Failed;
+    }
+    entry.build = nullptr;
+    entry.state.store(state, std::memory_order_release);
+  }
+} // namespace kopi
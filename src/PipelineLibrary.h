@@ -0,0 +1,130 @@
+#pragma once
+
+#include "EngineDevice.h"
+#include "Pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace kopi {
+  struct PipelineEntry {
+    enum class State { Pending, Ready, Failed };
+
+    uint64_t key = 0;
+    std::atomic<State> state{State::Pending};
+    std::unique_ptr<Pipeline> pipeline; // set before state turns Ready, never changed after
+    std::function<std::unique_ptr<Pipeline>()> build; // dropped once it has run
+  };
+
+  // A pipeline of a PipelineLibrary that may still be compiling. Cheap to copy, every copy refers
+  // to the same pipeline, which lives as long as the library or any handle to it.
+  class PipelineHandle {
+  public:
+    PipelineHandle() = default;
+
+    bool ready() const {
+      return m_entry && m_entry->state.load(std::memory_order_acquire) ==
+                            PipelineEntry::State::Ready;
+    }
+    // Creation threw, the error has been logged. The handle never becomes ready.
+    bool failed() const {
+      return m_entry && m_entry->state.load(std::memory_order_acquire) ==
+                            PipelineEntry::State::Failed;
+    }
+    // Null until ready.
+    Pipeline *get() const { return ready() ? m_entry->pipeline.get() : nullptr; }
+    Pipeline *operator->() const { return get(); }
+
+    // Identifies the config and shaders the pipeline was requested with.
+    uint64_t key() const { return m_entry ? m_entry->key : 0; }
+
+  private:
+    friend class PipelineLibrary;
+    explicit PipelineHandle(std::shared_ptr<PipelineEntry> entry) : m_entry(std::move(entry)) {}
+
+    std::shared_ptr<PipelineEntry> m_entry;
+  };
+
+  // Creates every pipeline once. Requests are keyed by a hash of the fixed function state, the
+  // layout, the render pass, the shaders and their specialization constants, so systems asking
+  // for the same pipeline share it, and the pipeline is compiled on the library's own threads
+  // while the caller carries on with a handle that turns ready later. Systems skip what they
+  // would draw with a pipeline that is not ready yet, so new pipelines or variants cost a few
+  // frames without it rather than a hitch.
+  //
+  // Layouts come from the library too and are deduplicated by content, so two systems with the
+  // same push constants and descriptor sets end up with the same layout handle and share their
+  // pipelines. The library destroys them last, after its compile threads have stopped, so a
+  // layout outlives every compile that uses it and no handle value in a key is ever reused.
+  //
+  // The compile threads are separate from the JobSystem on purpose: a frame waiting on its jobs
+  // runs whatever is queued, and picking up a compile there would stall it for the whole compile.
+  class PipelineLibrary {
+  public:
+    explicit PipelineLibrary(
+        EngineDevice &device,
+        unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency() / 2));
+    // Waits for the compiles in progress and drops the ones not started.
+    ~PipelineLibrary();
+
+    PipelineLibrary(const PipelineLibrary &)            = delete;
+    PipelineLibrary &operator=(const PipelineLibrary &) = delete;
+
+    // Created on first request, the handles stay valid until the library is destroyed and must
+    // not be destroyed by the caller. Immutable samplers are not supported.
+    VkDescriptorSetLayout descriptorSetLayout(
+        const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+    // setLayouts must come from descriptorSetLayout.
+    VkPipelineLayout pipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts,
+                                    const std::vector<VkPushConstantRange> &pushConstantRanges);
+
+    // configInfo is copied, it does not have to outlive the call. Its pipeline layout, like the
+    // one passed to compute, must come from pipelineLayout.
+    PipelineHandle graphics(const std::string &vertFilePath,
+                            const std::string &fragFilePath,
+                            const PipelineConfigInfo &configInfo);
+    PipelineHandle compute(const std::string &compFilePath,
+                           VkPipelineLayout pipelineLayout,
+                           const SpecializationConstants &specialization = {});
+
+    // Blocks until handle is ready or failed, compiling it on the calling thread if no compile
+    // thread has picked it up yet. For loading screens and tools, never from the frame loop.
+    void wait(const PipelineHandle &handle);
+    void waitIdle();
+
+    // distinct pipelines requested so far
+    size_t size() const;
+    size_t pendingCount() const;
+
+  private:
+    PipelineHandle request(uint64_t key, std::function<std::unique_ptr<Pipeline>()> build);
+    void compileLoop();
+    void compile(PipelineEntry &entry);
+    bool ownsPipelineLayout(VkPipelineLayout layout) const;
+
+    EngineDevice &m_device;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;     // work queued or stopping
+    std::condition_variable m_compiled; // an entry left Pending
+    std::unordered_map<uint64_t, std::shared_ptr<PipelineEntry>> m_entries;
+    std::deque<std::shared_ptr<PipelineEntry>> m_queue;
+    // by content hash
+    std::unordered_map<uint64_t, VkDescriptorSetLayout> m_descriptorSetLayouts;
+    std::unordered_map<uint64_t, VkPipelineLayout> m_pipelineLayouts;
+    size_t m_compiling = 0;
+    bool m_stop        = false;
+    std::vector<std::thread> m_threads;
+  };
+} // namespace kopi
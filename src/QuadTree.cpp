@@ -0,0 +1,197 @@
+#include "QuadTree.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+
+namespace kopi {
+
+  void QuadTree::build(const float *posX, const float *posY, const float *mass, size_t count) {
+    m_posX = posX;
+    m_posY = posY;
+    m_mass = mass;
+
+    m_nodes.clear();
+    m_order.resize(count);
+    if (count == 0) {
+      return;
+    }
+
+    glm::vec2 minPos{posX[0], posY[0]};
+    glm::vec2 maxPos{posX[0], posY[0]};
+    for (uint32_t i = 0; i < count; i++) {
+      m_order[i] = i;
+      minPos     = glm::min(minPos, glm::vec2{posX[i], posY[i]});
+      maxPos     = glm::max(maxPos, glm::vec2{posX[i], posY[i]});
+    }
+
+    // square root node, padded slightly so bodies on the max edge still land inside it
+    glm::vec2 extent = maxPos - minPos;
+    Node root{};
+    root.centre   = (minPos + maxPos) * 0.5f;
+    root.halfSize = glm::max(extent.x, extent.y) * 0.5f * 1.0001f + 1e-6f;
+    root.begin    = 0;
+    root.end      = static_cast<uint32_t>(count);
+
+    m_nodes.reserve(count);
+    m_nodes.push_back(root);
+    subdivide(0, 0);
+  }
+
+  void QuadTree::subdivide(uint32_t nodeIndex, uint32_t depth) {
+    // copy out, m_nodes may reallocate while children are appended
+    const Node node = m_nodes[nodeIndex];
+
+    if (node.end - node.begin <= LEAF_CAPACITY || depth >= MAX_DEPTH) {
+      float mass = 0.0f;
+      glm::vec2 weighted{};
+      for (uint32_t k = node.begin; k < node.end; k++) {
+        uint32_t j = m_order[k];
+        mass += m_mass[j];
+        weighted += m_mass[j] * glm::vec2{m_posX[j], m_posY[j]};
+      }
+      glm::vec2 centreOfMass = mass > 0.0f ? weighted / mass : node.centre;
+
+      Node &leaf        = m_nodes[nodeIndex];
+      leaf.mass         = mass;
+      leaf.centreOfMass = centreOfMass;
+      for (uint32_t k = node.begin; k < node.end; k++) {
+        uint32_t j = m_order[k];
+        addQuadrupole(leaf, m_mass[j], glm::vec2{m_posX[j], m_posY[j]} - centreOfMass);
+      }
+      return;
+    }
+
+    // split the range into quadrants: [x<, y<] [x<, y>=] [x>=, y<] [x>=, y>=]
+    auto first = m_order.begin() + node.begin;
+    auto last  = m_order.begin() + node.end;
+    auto midX  = std::partition(first, last, [&](uint32_t j) { return m_posX[j] < node.centre.x; });
+    auto lowY  = std::partition(first, midX, [&](uint32_t j) { return m_posY[j] < node.centre.y; });
+    auto highY = std::partition(midX, last, [&](uint32_t j) { return m_posY[j] < node.centre.y; });
+
+    const std::array<decltype(first), 5> bounds{first, lowY, midX, highY, last};
+    const std::array<glm::vec2, 4> offsets{
+        glm::vec2{-1.0f, -1.0f},
+        glm::vec2{-1.0f, 1.0f },
+        glm::vec2{1.0f,  -1.0f},
+        glm::vec2{1.0f,  1.0f }
+    };
+
+    uint32_t firstChild = static_cast<uint32_t>(m_nodes.size());
+    uint32_t childCount = 0;
+    for (int q = 0; q < 4; q++) {
+      if (bounds[q] == bounds[q + 1]) {
+        continue;
+      }
+      Node child{};
+      child.halfSize = node.halfSize * 0.5f;
+      child.centre   = node.centre + offsets[q] * child.halfSize;
+      child.begin    = static_cast<uint32_t>(bounds[q] - m_order.begin());
+      child.end      = static_cast<uint32_t>(bounds[q + 1] - m_order.begin());
+      m_nodes.push_back(child);
+      childCount++;
+    }
+
+    m_nodes[nodeIndex].firstChild = firstChild;
+    m_nodes[nodeIndex].childCount = childCount;
+
+    float mass = 0.0f;
+    glm::vec2 weighted{};
+    for (uint32_t c = firstChild; c < firstChild + childCount; c++) {
+      subdivide(c, depth + 1);
+      mass += m_nodes[c].mass;
+      weighted += m_nodes[c].mass * m_nodes[c].centreOfMass;
+    }
+    glm::vec2 centreOfMass = mass > 0.0f ? weighted / mass : node.centre;
+
+    // children's moments shifted onto the parent's centre of mass (parallel axis theorem)
+    Node &parent        = m_nodes[nodeIndex];
+    parent.mass         = mass;
+    parent.centreOfMass = centreOfMass;
+    parent.comOffset    = glm::length(centreOfMass - node.centre);
+    for (uint32_t c = firstChild; c < firstChild + childCount; c++) {
+      const Node &child = m_nodes[c];
+      parent.quadXX += child.quadXX;
+      parent.quadXY += child.quadXY;
+      parent.quadYY += child.quadYY;
+      addQuadrupole(parent, child.mass, child.centreOfMass - centreOfMass);
+    }
+  }
+
+  void QuadTree::addQuadrupole(Node &node, float mass, glm::vec2 offset) {
+    float r2 = glm::dot(offset, offset);
+    node.quadXX += mass * (3.0f * offset.x * offset.x - r2);
+    node.quadXY += mass * (3.0f * offset.x * offset.y);
+    node.quadYY += mass * (3.0f * offset.y * offset.y - r2);
+  }
+
+  glm::vec2 QuadTree::computeAcceleration(glm::vec2 position,
+                                          uint32_t self,
+                                          float theta,
+                                          float strength) const {
+    glm::vec2 acceleration{};
+    if (m_nodes.empty()) {
+      return acceleration;
+    }
+
+    // every level pushes at most 4 children and pops one, so 3 * depth + 4 bounds the stack
+    std::array<uint32_t, 3 * MAX_DEPTH + 4> stack;
+    uint32_t stackSize   = 0;
+    stack[stackSize++]   = 0;
+    const float invTheta = 1.0f / theta;
+
+    while (stackSize > 0) {
+      const Node &node = m_nodes[stack[--stackSize]];
+      if (node.mass == 0.0f) {
+        continue;
+      }
+
+      if (node.childCount == 0) {
+        for (uint32_t k = node.begin; k < node.end; k++) {
+          uint32_t j = m_order[k];
+          if (j == self) {
+            continue;
+          }
+          glm::vec2 offset      = glm::vec2{m_posX[j], m_posY[j]} - position;
+          float distanceSquared = glm::dot(offset, offset);
+          if (distanceSquared < 1e-10f) {
+            continue;
+          }
+          acceleration += m_mass[j] * offset / (distanceSquared * glm::sqrt(distanceSquared));
+        }
+        continue;
+      }
+
+      glm::vec2 offset      = node.centreOfMass - position;
+      float distanceSquared = glm::dot(offset, offset);
+      // widen the opening distance by how far the centre of mass sits from the cell centre, so
+      // cells with their mass bunched in the corner nearest the target still get opened
+      float openRadius      = 2.0f * node.halfSize * invTheta + node.comOffset;
+      bool containsPosition = glm::abs(position.x - node.centre.x) <= node.halfSize &&
+                              glm::abs(position.y - node.centre.y) <= node.halfSize;
+
+      if (!containsPosition && openRadius * openRadius < distanceSquared) {
+        // monopole + quadrupole expansion about the centre of mass, r points from it to the target
+        glm::vec2 r     = -offset;
+        float invR2     = 1.0f / distanceSquared;
+        float invR      = glm::sqrt(invR2);
+        float invR3     = invR * invR2;
+        float invR5     = invR3 * invR2;
+        glm::vec2 quadR = {node.quadXX * r.x + node.quadXY * r.y,
+                           node.quadXY * r.x + node.quadYY * r.y};
+        float rQuadR    = glm::dot(r, quadR);
+
+        acceleration += -node.mass * invR3 * r + invR5 * quadR - 2.5f * rQuadR * invR5 * invR2 * r;
+        continue;
+      }
+
+      ASSERT_LOG(stackSize + node.childCount <= stack.size(), "Quadtree traversal stack overflow");
+      for (uint32_t c = 0; c < node.childCount; c++) {
+        stack[stackSize++] = node.firstChild + c;
+      }
+    }
+
+    return strength * acceleration;
+  }
+
+} // namespace kopi
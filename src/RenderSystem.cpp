@@ -1,7 +1,7 @@
 #include "RenderSystem.h"
-#include "GameObject.h"
 #include "Log.h"
 #include "glm/gtc/constants.hpp"
+#include <algorithm>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -12,39 +12,22 @@ namespace kopi {
     alignas(16) glm::vec3 colour;
   };
 
-  RenderSystem::RenderSystem(EngineDevice &device, VkRenderPass renderPass) : m_device{device} {
-    createPipelineLayout();
-    createPipeline(renderPass);
+  RenderSystem::RenderSystem(PipelineLibrary &pipelines, VkRenderPass renderPass) {
+    createPipelineLayout(pipelines);
+    createPipeline(pipelines, renderPass);
+    createInstancedPipeline(pipelines, renderPass);
   }
 
-  RenderSystem::~RenderSystem() {
-    vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
-  }
-
-  void RenderSystem::createPipelineLayout() {
-
+  void RenderSystem::createPipelineLayout(PipelineLibrary &pipelines) {
     VkPushConstantRange pushConstantRange{};
     pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
     pushConstantRange.offset     = 0;
     pushConstantRange.size       = sizeof(SimplePushConstantData);
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount         = 0;
-    pipelineLayoutInfo.pSetLayouts            = nullptr;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges    = &pushConstantRange;
-
-    if (vkCreatePipelineLayout(m_device.device(),
-                               &pipelineLayoutInfo,
-                               nullptr,
-                               &m_pipelineLayout) != VK_SUCCESS) {
-      LOG_ERROR("Failed to create pipeline layout!");
-      throw std::runtime_error("Failed to create pipeline layout!");
-    }
+    m_pipelineLayout = pipelines.pipelineLayout({}, {pushConstantRange});
   }
 
-  void RenderSystem::createPipeline(VkRenderPass renderPass) {
+  void RenderSystem::createPipeline(PipelineLibrary &pipelines, VkRenderPass renderPass) {
     ASSERT_LOG(m_pipelineLayout != nullptr, "Cannot create pipeline before pipeline layout!");
 
     PipelineConfigInfo pipelineConfig{};
@@ -53,31 +36,173 @@ namespace kopi {
     pipelineConfig.renderPass     = renderPass;
     pipelineConfig.pipelineLayout = m_pipelineLayout;
 
-    m_pipeline = std::make_unique<Pipeline>(m_device,
-                                            "src/shaders/simple.vert.spv",
-                                            "src/shaders/simple.frag.spv",
-                                            pipelineConfig);
+    m_pipeline = pipelines.graphics("src/shaders/simple.vert.spv",
+                                    "src/shaders/simple.frag.spv",
+                                    pipelineConfig);
   }
 
-  void RenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject> &gameObjects) {
+  void RenderSystem::createInstancedPipeline(PipelineLibrary &pipelines,
+                                             VkRenderPass renderPass) {
+    ASSERT_LOG(m_pipelineLayout != nullptr, "Cannot create pipeline before pipeline layout!");
+
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+
+    // the push constant range of the shared layout goes unused, everything arrives per instance
+    pipelineConfig.renderPass     = renderPass;
+    pipelineConfig.pipelineLayout = m_pipelineLayout;
+
+    auto instanceBindings   = Model::InstanceData::getBindingDescriptions();
+    auto instanceAttributes = Model::InstanceData::getAttributeDescriptions();
+    pipelineConfig.bindingDescriptions.insert(pipelineConfig.bindingDescriptions.end(),
+                                              instanceBindings.begin(),
+                                              instanceBindings.end());
+    pipelineConfig.attributeDescriptions.insert(pipelineConfig.attributeDescriptions.end(),
+                                                instanceAttributes.begin(),
+                                                instanceAttributes.end());
+
+    m_instancedPipeline = pipelines.graphics("src/shaders/instanced.vert.spv",
+                                             "src/shaders/instanced.frag.spv",
+                                             pipelineConfig);
+  }
+
+  void RenderSystem::renderEntities(VkCommandBuffer commandBuffer, World &world) {
+    if (!m_pipeline.ready()) {
+      return;
+    }
     m_pipeline->bind(commandBuffer);
 
-    for (auto &obj : gameObjects) {
-      obj.transform2d.rotation = glm::mod(obj.transform2d.rotation + 0.01f, glm::two_pi<float>());
-
-      SimplePushConstantData push{};
-      push.offset    = obj.transform2d.translation;
-      push.colour    = obj.color;
-      push.transform = obj.transform2d.mat2();
-
-      vkCmdPushConstants(commandBuffer,
-                         m_pipelineLayout,
-                         VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                         0,
-                         sizeof(SimplePushConstantData),
-                         &push);
-      obj.model->bind(commandBuffer);
-      obj.model->draw(commandBuffer);
+    world.view<Transform2dComponent, ColourComponent, ModelComponent>().each(
+        [&](Transform2dComponent &transform, ColourComponent &colour, ModelComponent &model) {
+          SimplePushConstantData push{};
+          push.offset    = transform.translation;
+          push.colour    = colour.colour;
+          push.transform = transform.matrix;
+
+          vkCmdPushConstants(commandBuffer,
+                             m_pipelineLayout,
+                             VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                             0,
+                             sizeof(SimplePushConstantData),
+                             &push);
+          model.model->bind(commandBuffer);
+          model.model->draw(commandBuffer);
+        });
+  }
+
+  void RenderSystem::renderEntitiesParallel(Renderer &renderer,
+                                            VkCommandBuffer commandBuffer,
+                                            JobSystem *jobSystem,
+                                            World &world) {
+    if (!m_pipeline.ready()) {
+      return;
+    }
+    m_draws.clear();
+    m_drawModels.clear();
+    world.view<Transform2dComponent, ColourComponent, ModelComponent>().each(
+        [&](Transform2dComponent &transform, ColourComponent &colour, ModelComponent &model) {
+          m_draws.push_back({transform.matrix, transform.translation, colour.colour});
+          m_drawModels.push_back(model.model.get());
+        });
+
+    renderer.recordSecondary(
+        commandBuffer,
+        jobSystem,
+        m_draws.size(),
+        DRAW_GRAIN,
+        [&](VkCommandBuffer secondary, size_t begin, size_t end) {
+          m_pipeline->bind(secondary);
+          Model *bound = nullptr;
+          for (size_t i = begin; i < end; i++) {
+            SimplePushConstantData push{};
+            push.offset    = m_draws[i].offset;
+            push.colour    = m_draws[i].colour;
+            push.transform = m_draws[i].transform;
+
+            vkCmdPushConstants(secondary,
+                               m_pipelineLayout,
+                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                               0,
+                               sizeof(SimplePushConstantData),
+                               &push);
+            // most neighbours share a model, its buffers stay bound
+            if (m_drawModels[i] != bound) {
+              bound = m_drawModels[i];
+              bound->bind(secondary);
+            }
+            bound->draw(secondary);
+          }
+        });
+  }
+
+  void RenderSystem::renderEntitiesInstanced(VkCommandBuffer commandBuffer,
+                                             FrameRingBuffer &frameData,
+                                             World &world) {
+    // without its shaders the instanced pipeline never turns ready, the library has logged why
+    if (m_instancedPipeline.failed()) {
+      renderEntities(commandBuffer, world);
+      return;
+    }
+    auto drawables     = world.view<Transform2dComponent, ColourComponent, ModelComponent>();
+    const size_t count = drawables.size();
+    if (count == 0 || !m_instancedPipeline.ready()) {
+      return;
+    }
+
+    // one batch per model, there are only a handful so a linear search is enough
+    m_batchModels.clear();
+    m_batchOffsets.clear();
+    m_objectBatches.resize(count);
+    size_t batch = 0;
+    size_t i     = 0;
+    for (auto chunk : drawables) {
+      for (const auto &model : chunk.get<ModelComponent>()) {
+        Model *current = model.model.get();
+        if (batch >= m_batchModels.size() || m_batchModels[batch] != current) {
+          auto found = std::find(m_batchModels.begin(), m_batchModels.end(), current);
+          batch      = static_cast<size_t>(found - m_batchModels.begin());
+          if (batch == m_batchModels.size()) {
+            m_batchModels.push_back(current);
+            m_batchOffsets.push_back(0);
+          }
+        }
+        m_objectBatches[i++] = static_cast<uint32_t>(batch);
+        m_batchOffsets[batch]++;
+      }
+    }
+
+    // counts to start offsets, each is advanced while writing and ends up at the next batch start
+    size_t start = 0;
+    for (auto &offset : m_batchOffsets) {
+      size_t batchCount = offset;
+      offset            = start;
+      start += batchCount;
+    }
+
+    FrameAllocation allocation{};
+    Model::InstanceData *instances = frameData.allocate<Model::InstanceData>(count, allocation);
+    i                              = 0;
+    for (auto chunk : drawables) {
+      auto transforms = chunk.get<Transform2dComponent>();
+      auto colours    = chunk.get<ColourComponent>();
+      for (size_t row = 0; row < chunk.size(); row++, i++) {
+        Model::InstanceData &instance = instances[m_batchOffsets[m_objectBatches[i]]++];
+        instance.transform            = transforms[row].matrix;
+        instance.offset               = transforms[row].translation;
+        instance.colour               = colours[row].colour;
+      }
+    }
+
+    m_instancedPipeline->bind(commandBuffer);
+    size_t first = 0;
+    for (size_t b = 0; b < m_batchModels.size(); b++) {
+      const size_t end = m_batchOffsets[b];
+      m_batchModels[b]->bind(commandBuffer);
+      VkBuffer instanceBuffers[] = {allocation.buffer};
+      VkDeviceSize offsets[]     = {allocation.offset + first * sizeof(Model::InstanceData)};
+      vkCmdBindVertexBuffers(commandBuffer, 1, 1, instanceBuffers, offsets);
+      m_batchModels[b]->draw(commandBuffer, static_cast<uint32_t>(end - first));
+      first = end;
     }
   }
 
@@ -1,8 +1,14 @@
 #pragma once
 
 #include "EngineDevice.h"
-#include "GameObject.h"
+#include "FrameRingBuffer.h"
+#include "JobSystem.h"
 #include "Pipeline.h"
+#include "PipelineLibrary.h"
+#include "Renderer.h"
+#include "SwapChain.h"
+#include "World.h"
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
@@ -13,21 +19,51 @@
 namespace kopi {
   class RenderSystem {
   public:
-    RenderSystem(EngineDevice &device, VkRenderPass renderPass);
-    ~RenderSystem();
+    // The pipelines come from pipelines and compile in the background, every render call draws
+    // nothing until the one it uses is ready.
+    RenderSystem(PipelineLibrary &pipelines, VkRenderPass renderPass);
 
     RenderSystem(const RenderSystem &)            = delete;
     RenderSystem &operator=(const RenderSystem &) = delete;
 
-    void renderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject> &gameObjects);
+    // Draws every entity with a transform, colour and model, one draw call each. Transform
+    // matrices are taken as they are, so TransformSystem::update has to run first.
+    void renderEntities(VkCommandBuffer commandBuffer, World &world);
+
+    // Same result with one draw per distinct Model: transforms, offsets and colours are written to
+    // frameData, the renderer's, and read at instance rate. Entities are grouped by model, so
+    // draw order only holds among entities sharing one. Falls back to renderEntities if the
+    // instanced pipeline failed to build.
+    void renderEntitiesInstanced(VkCommandBuffer commandBuffer,
+                                 FrameRingBuffer &frameData,
+                                 World &world);
+
+    // Same draws as renderEntities, in the same order, recorded into secondary command buffers
+    // DRAW_GRAIN entities at a time on jobSystem's threads. The render pass must have been begun
+    // with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    void renderEntitiesParallel(Renderer &renderer,
+                                VkCommandBuffer commandBuffer,
+                                JobSystem *jobSystem,
+                                World &world);
+
+    // entities per secondary command buffer, enough that beginning one is lost in the draws
+    static constexpr size_t DRAW_GRAIN = 1024;
 
   private:
-    void createPipelineLayout();
-    void createPipeline(VkRenderPass renderPass);
+    void createPipelineLayout(PipelineLibrary &pipelines);
+    void createPipeline(PipelineLibrary &pipelines, VkRenderPass renderPass);
+    void createInstancedPipeline(PipelineLibrary &pipelines, VkRenderPass renderPass);
+
+    PipelineHandle m_pipeline;
+    PipelineHandle m_instancedPipeline;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE; // the library's
 
-    EngineDevice &m_device;
+    std::vector<Model *> m_batchModels;
+    std::vector<size_t> m_batchOffsets;
+    std::vector<uint32_t> m_objectBatches;
 
-    std::unique_ptr<Pipeline> m_pipeline;
-    VkPipelineLayout m_pipelineLayout;
+    // renderEntitiesParallel's draws, gathered up front so the slices only read
+    std::vector<Model::InstanceData> m_draws;
+    std::vector<Model *> m_drawModels;
   };
 } // namespace kopi
\ No newline at end of file
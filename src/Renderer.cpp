@@ -14,7 +14,14 @@ namespace kopi {
     createCommandBuffers();
   }
 
-  Renderer::~Renderer() { freeCommandBuffers(); }
+  Renderer::~Renderer() {
+    for (auto &frame : m_secondaryPools) {
+      for (auto &secondary : frame) {
+        vkDestroyCommandPool(m_device.device(), secondary.pool, nullptr);
+      }
+    }
+    freeCommandBuffers();
+  }
 
   VkCommandBuffer Renderer::beginFrame() {
     ASSERT_LOG(!m_isFrameStarted, "Can't call beginFrame while already in progress!");
@@ -29,6 +36,13 @@ namespace kopi {
     }
 
     m_isFrameStarted = true;
+    // acquireNextImage waited on this frame's fence, so nothing of the frame is in use anymore
+    m_frameData.beginFrame(static_cast<uint32_t>(m_currentFrameIndex));
+    auto &secondaryPools = m_secondaryPools[m_currentFrameIndex];
+    for (size_t i = 0; i < m_secondaryPoolsUsed[m_currentFrameIndex]; i++) {
+      vkResetCommandPool(m_device.device(), secondaryPools[i].pool, 0);
+    }
+    m_secondaryPoolsUsed[m_currentFrameIndex] = 0;
 
     auto commandBuffer = getCurrentCommandBuffer();
     VkCommandBufferBeginInfo beginInfo{};
@@ -48,7 +62,9 @@ namespace kopi {
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
       throw std::runtime_error("failed to record command buffer!");
     }
-    auto result = m_swapChain->submitCommandBuffers(&commandBuffer, &m_currentImageIndex);
+    auto result =
+        m_swapChain->submitCommandBuffers(&commandBuffer, &m_currentImageIndex, m_timelineWaits);
+    m_timelineWaits.clear();
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
         m_window.wasWindowResized()) {
@@ -63,19 +79,22 @@ namespace kopi {
     m_currentFrameIndex = (m_currentFrameIndex +1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
   }
 
-  void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+  void Renderer::addTimelineWait(const TimelineWait &wait) {
+    ASSERT_LOG(m_isFrameStarted, "Can't add a wait while no frame is in progress!");
+    // value 0 is where every timeline starts
+    if (wait.value > 0) {
+      m_timelineWaits.push_back(wait);
+    }
+  }
+
+  void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                          VkSubpassContents contents) {
     ASSERT_LOG(m_isFrameStarted, "Can't call beginSwapChainRenderPass while already in progress!");
     ASSERT_LOG(commandBuffer == getCurrentCommandBuffer(),
                "Can't begin render pass on a command buffer from a different frame! ");
 
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-      LOG_ERROR("Failed to begin recording command buffer!");
-      throw std::runtime_error("Failed to begin recording command buffer!");
-    }
-
+    // beginFrame has already begun the command buffer, work recorded before the pass such as
+    // compute dispatches stays in it
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass        = m_swapChain->getRenderPass();
@@ -91,8 +110,15 @@ namespace kopi {
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues    = clearValues.data();
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+    // secondaries set their own, the primary may not record anything else in such a pass
+    if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+      setViewportAndScissor(commandBuffer);
+    }
+  }
 
+  void Renderer::setViewportAndScissor(VkCommandBuffer commandBuffer) {
     VkViewport viewport{};
     viewport.x        = 0.0f;
     viewport.y        = 0.0f;
@@ -115,6 +141,98 @@ namespace kopi {
     vkCmdEndRenderPass(commandBuffer);
   }
 
+  void Renderer::recordSecondary(VkCommandBuffer commandBuffer,
+                                 JobSystem *jobSystem,
+                                 size_t count,
+                                 size_t grain,
+                                 const SecondaryRecordFunction &fn) {
+    ASSERT_LOG(m_isFrameStarted, "Can't record secondaries while frame not in progress!");
+    ASSERT_LOG(grain > 0, "Secondary grain must not be 0");
+    if (count == 0) {
+      return;
+    }
+
+    const size_t rangeCount = (count + grain - 1) / grain;
+    const size_t firstPool  = m_secondaryPoolsUsed[m_currentFrameIndex];
+    reserveSecondaryPools(firstPool + rangeCount);
+    m_secondaryPoolsUsed[m_currentFrameIndex] = firstPool + rangeCount;
+    const auto &pools                         = m_secondaryPools[m_currentFrameIndex];
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass  = m_swapChain->getRenderPass();
+    inheritanceInfo.subpass     = 0;
+    inheritanceInfo.framebuffer = m_swapChain->getFrameBuffer(m_currentImageIndex);
+
+    auto recordRange = [&](size_t range) {
+      VkCommandBuffer secondary = pools[firstPool + range].commandBuffer;
+
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      beginInfo.pInheritanceInfo = &inheritanceInfo;
+      if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+        LOG_ERROR("Failed to begin recording secondary command buffer!");
+        throw std::runtime_error("Failed to begin recording secondary command buffer!");
+      }
+      setViewportAndScissor(secondary);
+      fn(secondary, range * grain, std::min(count, (range + 1) * grain));
+      if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+        LOG_ERROR("Failed to record secondary command buffer!");
+        throw std::runtime_error("Failed to record secondary command buffer!");
+      }
+    };
+    if (jobSystem != nullptr) {
+      jobSystem->parallelFor(rangeCount, 1, [&](size_t begin, size_t end) {
+        for (size_t range = begin; range < end; range++) {
+          recordRange(range);
+        }
+      });
+    } else {
+      for (size_t range = 0; range < rangeCount; range++) {
+        recordRange(range);
+      }
+    }
+
+    m_secondaries.clear();
+    for (size_t range = 0; range < rangeCount; range++) {
+      m_secondaries.push_back(pools[firstPool + range].commandBuffer);
+    }
+    vkCmdExecuteCommands(commandBuffer,
+                         static_cast<uint32_t>(m_secondaries.size()),
+                         m_secondaries.data());
+  }
+
+  void Renderer::reserveSecondaryPools(size_t count) {
+    auto &pools = m_secondaryPools[m_currentFrameIndex];
+    while (pools.size() < count) {
+      SecondaryPool secondary{};
+
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.queueFamilyIndex = m_device.findPhysicalQueueFamilies().graphicsFamily;
+      poolInfo.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+      if (vkCreateCommandPool(m_device.device(), &poolInfo, nullptr, &secondary.pool) !=
+          VK_SUCCESS) {
+        LOG_ERROR("Failed to create secondary command pool!");
+        throw std::runtime_error("Failed to create secondary command pool!");
+      }
+
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      allocInfo.commandPool        = secondary.pool;
+      allocInfo.commandBufferCount = 1;
+      if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, &secondary.commandBuffer) !=
+          VK_SUCCESS) {
+        LOG_ERROR("Failed to allocate secondary command buffer!");
+        throw std::runtime_error("Failed to allocate secondary command buffer!");
+      }
+      pools.push_back(secondary);
+    }
+  }
+
   void Renderer::recreateSwapChain() {
     auto extent = m_window.getExtent();
 
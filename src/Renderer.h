@@ -1,9 +1,13 @@
 #pragma once
 
 #include "EngineDevice.h"
+#include "FrameRingBuffer.h"
+#include "JobSystem.h"
 #include "SwapChain.h"
 #include "Window.h"
+#include <array>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -24,22 +28,59 @@ namespace kopi {
     VkRenderPass getSwapChainRenderPass() const;
     VkCommandBuffer getCurrentCommandBuffer() const;
     int getFrameIndex() const;
+    // per frame streaming memory, already started over for the current frame
+    FrameRingBuffer &getFrameData() { return m_frameData; }
 
     VkCommandBuffer beginFrame();
     void endFrame();
+    // The current frame's submission will wait for wait, for data it reads that another queue
+    // is still producing, such as uploads. Cleared once the frame is submitted.
+    void addTimelineWait(const TimelineWait &wait);
 
-    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+    // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only be filled through
+    // recordSecondary.
+    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                  VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+    using SecondaryRecordFunction =
+        std::function<void(VkCommandBuffer commandBuffer, size_t begin, size_t end)>;
+    // Records [0, count) in ranges of at most grain, each into its own secondary command buffer
+    // on jobSystem's threads, or on the calling thread when it is null, then executes them on
+    // commandBuffer in range order. Every secondary starts with viewport and scissor set and
+    // nothing bound. The render pass must have been begun for secondary command buffers.
+    void recordSecondary(VkCommandBuffer commandBuffer,
+                         JobSystem *jobSystem,
+                         size_t count,
+                         size_t grain,
+                         const SecondaryRecordFunction &fn);
+
   private:
+    // A command pool is used by one thread at a time, so every range recorded in a frame gets a
+    // pool of its own, whichever thread ends up recording it. The pool and its one secondary are
+    // reset and reused when the frame comes round again.
+    struct SecondaryPool {
+      VkCommandPool pool            = VK_NULL_HANDLE;
+      VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    };
+
     void createCommandBuffers();
     void freeCommandBuffers();
     void recreateSwapChain();
+    void setViewportAndScissor(VkCommandBuffer commandBuffer);
+    void reserveSecondaryPools(size_t count);
 
     Window &m_window;
     EngineDevice &m_device;
     std::unique_ptr<SwapChain> m_swapChain;
     std::vector<VkCommandBuffer> m_commandBuffers;
+    std::vector<TimelineWait> m_timelineWaits;
+    FrameRingBuffer m_frameData{m_device, SwapChain::MAX_FRAMES_IN_FLIGHT};
+
+    std::array<std::vector<SecondaryPool>, SwapChain::MAX_FRAMES_IN_FLIGHT> m_secondaryPools;
+    // pools of each frame handed out since it began
+    std::array<size_t, SwapChain::MAX_FRAMES_IN_FLIGHT> m_secondaryPoolsUsed{};
+    std::vector<VkCommandBuffer> m_secondaries;
 
     uint32_t m_currentImageIndex = 0;
     int m_currentFrameIndex      = 0;
@@ -0,0 +1,165 @@
+#include "ShaderModuleCache.h"
+#include "Hash.h"
+#include "Log.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kopi {
+  static constexpr uint32_t SPIRV_MAGIC         = 0x07230203;
+  static constexpr size_t SPIRV_HEADER_WORDS    = 5;
+  static constexpr uint32_t SPIRV_MAGIC_SWAPPED = 0x03022307;
+
+  namespace {
+  // A whole file mapped read only. Mappings start on a page boundary, so the data is aligned for
+  // the uint32_t words SPIR-V is made of. Without mmap the file is read into words instead.
+  class MappedFile {
+  public:
+    explicit MappedFile(const std::string &filePath) {
+#ifdef _WIN32
+      std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+      if (!file.is_open()) {
+        return;
+      }
+      m_size = static_cast<size_t>(file.tellg());
+      m_words.resize((m_size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+      file.seekg(0);
+      file.read(reinterpret_cast<char *>(m_words.data()), static_cast<std::streamsize>(m_size));
+      m_data = m_words.data();
+      m_open = static_cast<bool>(file);
+#else
+      const int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return;
+      }
+      struct stat info {};
+      if (::fstat(fd, &info) == 0) {
+        m_size = static_cast<size_t>(info.st_size);
+        m_open = true;
+        if (m_size > 0) {
+          void *mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (mapping == MAP_FAILED) {
+            m_open = false;
+          } else {
+            m_data = mapping;
+          }
+        }
+      }
+      ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#ifndef _WIN32
+      if (m_data != nullptr) {
+        ::munmap(const_cast<void *>(m_data), m_size);
+      }
+#endif
+    }
+
+    MappedFile(const MappedFile &)            = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return m_open; }
+    const void *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+  private:
+    bool m_open        = false;
+    const void *m_data = nullptr;
+    size_t m_size      = 0;
+#ifdef _WIN32
+    std::vector<uint32_t> m_words;
+#endif
+  };
+  } // namespace
+
+  ShaderModuleCache::ShaderModuleCache(VkDevice device) : m_device{device} {}
+
+  ShaderModuleCache::~ShaderModuleCache() {
+    for (auto &[hash, module] : m_byContent) {
+      vkDestroyShaderModule(m_device, module, nullptr);
+    }
+  }
+
+  VkShaderModule ShaderModuleCache::load(const std::string &filePath) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto known = m_byPath.find(filePath);
+    if (known != m_byPath.end()) {
+      m_stats.hits++;
+      return known->second;
+    }
+
+    MappedFile file(filePath);
+    m_stats.fileReads++;
+    if (!file.isOpen()) {
+      LOG_ERROR("Failed to open shader {}", filePath);
+      throw std::runtime_error("failed to open shader " + filePath);
+    }
+
+    // vkCreateShaderModule takes the code as uint32_t words, anything else is undefined behaviour
+    // or a driver crash rather than an error, so it is checked here
+    const size_t size = file.size();
+    const auto *code  = static_cast<const uint32_t *>(file.data());
+    if (size < SPIRV_HEADER_WORDS * sizeof(uint32_t) || size % sizeof(uint32_t) != 0) {
+      LOG_ERROR("Shader {} is {} bytes, not a whole number of SPIR-V words", filePath, size);
+      throw std::runtime_error("invalid SPIR-V size in " + filePath);
+    }
+    if (reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0) {
+      LOG_ERROR("Shader {} is not aligned to SPIR-V words", filePath);
+      throw std::runtime_error("misaligned SPIR-V in " + filePath);
+    }
+    if (code[0] != SPIRV_MAGIC) {
+      LOG_ERROR("Shader {} is not SPIR-V, magic {:#010x}{}",
+                filePath,
+                code[0],
+                code[0] == SPIRV_MAGIC_SWAPPED ? " (opposite byte order)" : "");
+      throw std::runtime_error("not SPIR-V: " + filePath);
+    }
+
+    // the same code under another path, a copy or a link, shares the module
+    const uint64_t hash = hashBytes(code, size);
+    VkShaderModule module;
+    auto shared = m_byContent.find(hash);
+    if (shared != m_byContent.end()) {
+      module = shared->second;
+    } else {
+      module = createModule(code, size, filePath);
+      m_byContent.emplace(hash, module);
+    }
+    m_byPath.emplace(filePath, module);
+    return module;
+  }
+
+  ShaderModuleCache::Stats ShaderModuleCache::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+  }
+
+  VkShaderModule ShaderModuleCache::createModule(const uint32_t *code,
+                                                 size_t size,
+                                                 const std::string &filePath) {
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = size;
+    createInfo.pCode    = code;
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(m_device, &createInfo, nullptr, &module) != VK_SUCCESS) {
+      LOG_ERROR("Failed to create shader module for {}!", filePath);
+      throw std::runtime_error("Failed to create shader module!");
+    }
+    m_stats.modules++;
+    LOG_DEBUG("Shader module for {}, {} bytes", filePath, size);
+    return module;
+  }
+} // namespace kopi
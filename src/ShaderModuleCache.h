@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vulkan/vulkan_core.h>
+
+namespace kopi {
+  // Shader modules shared by every pipeline that uses the same SPIR-V. A file is mapped and read
+  // once per path, and modules are keyed by a hash of the code, so two paths with identical
+  // contents share one module as well. SPIR-V is checked for its magic number and 4 byte size and
+  // alignment before it reaches the driver. Modules live until the cache is destroyed, variants
+  // of a pipeline created later reuse them. Thread safe, pipelines compile on several threads.
+  class ShaderModuleCache {
+  public:
+    struct Stats {
+      size_t fileReads = 0; // files mapped, one per distinct path
+      size_t modules   = 0; // modules created, one per distinct content
+      size_t hits      = 0; // loads served without touching the file system
+    };
+
+    explicit ShaderModuleCache(VkDevice device);
+    ~ShaderModuleCache();
+
+    ShaderModuleCache(const ShaderModuleCache &)            = delete;
+    ShaderModuleCache &operator=(const ShaderModuleCache &) = delete;
+
+    // The module for the SPIR-V in filePath, owned by the cache. Throws if the file can't be read
+    // or is not SPIR-V.
+    VkShaderModule load(const std::string &filePath);
+
+    Stats stats() const;
+
+  private:
+    VkShaderModule createModule(const uint32_t *code, size_t size, const std::string &filePath);
+
+    VkDevice m_device;
+
+    mutable std::mutex m_mutex; // held across a load, so a path is never read twice at once
+    std::unordered_map<std::string, VkShaderModule> m_byPath;
+    std::unordered_map<uint64_t, VkShaderModule> m_byContent;
+    Stats m_stats;
+  };
+} // namespace kopi
@@ -0,0 +1,108 @@
+#include "SimulationThread.h"
+#include "Log.h"
+
+#include <algorithm>
+
+namespace kopi {
+  SimulationThread::SimulationThread(BodyStore bodies, float stepDelta, StepFunction step)
+      : m_bodies{std::move(bodies)}, m_stepDelta{stepDelta}, m_step{std::move(step)} {
+    ASSERT_LOG(stepDelta > 0.0f, "Simulation step must be positive, got {}", stepDelta);
+
+    // the first snapshot is the initial state, so there is something to draw before the first step
+    SimulationSnapshot &snapshot = m_snapshots.writeBuffer();
+    snapshot.previousX.assign(m_bodies.posX.begin(), m_bodies.posX.begin() + m_bodies.size());
+    snapshot.previousY.assign(m_bodies.posY.begin(), m_bodies.posY.begin() + m_bodies.size());
+    snapshot.currentX    = snapshot.previousX;
+    snapshot.currentY    = snapshot.previousY;
+    snapshot.publishedAt = std::chrono::steady_clock::now();
+    snapshot.step        = 0;
+    m_snapshots.publish();
+  }
+
+  SimulationThread::~SimulationThread() { stop(); }
+
+  void SimulationThread::start() {
+    if (m_running.exchange(true)) {
+      return;
+    }
+    m_thread = std::thread([this] { threadLoop(); });
+  }
+
+  void SimulationThread::stop() {
+    m_running.store(false);
+    if (m_thread.joinable()) {
+      m_thread.join();
+    }
+  }
+
+  void SimulationThread::interpolate(World &world) {
+    if (m_failed.load(std::memory_order_acquire)) {
+      std::rethrow_exception(m_failure);
+    }
+
+    m_snapshots.acquire();
+    const SimulationSnapshot &snapshot = m_snapshots.readBuffer();
+    auto bodies = world.view<Transform2dComponent, RigidBody2dComponent>();
+    ASSERT_LOG(bodies.size() == snapshot.currentX.size(),
+               "Body count {} does not match the simulation's {} bodies",
+               bodies.size(),
+               snapshot.currentX.size());
+
+    std::chrono::duration<float> sincePublish =
+        std::chrono::steady_clock::now() - snapshot.publishedAt;
+    const float alpha = std::clamp(sincePublish.count() / m_stepDelta, 0.0f, 1.0f);
+    size_t i = 0;
+    for (auto chunk : bodies) {
+      auto transforms = chunk.get<Transform2dComponent>();
+      for (size_t row = 0; row < chunk.size(); row++, i++) {
+        transforms[row].translation = {
+            snapshot.previousX[i] + alpha * (snapshot.currentX[i] - snapshot.previousX[i]),
+            snapshot.previousY[i] + alpha * (snapshot.currentY[i] - snapshot.previousY[i])};
+      }
+    }
+  }
+
+  void SimulationThread::threadLoop() {
+    using Clock = std::chrono::steady_clock;
+    const std::chrono::duration<float> stepDuration{m_stepDelta};
+
+    try {
+      auto lastTime     = Clock::now();
+      float accumulator = 0.0f;
+      while (m_running.load(std::memory_order_relaxed)) {
+        auto now = Clock::now();
+        accumulator += std::chrono::duration<float>(now - lastTime).count();
+        lastTime    = now;
+        accumulator = std::min(accumulator, MAX_CATCH_UP_STEPS * m_stepDelta);
+
+        if (accumulator < m_stepDelta) {
+          std::this_thread::sleep_for(stepDuration * (1.0f - accumulator / m_stepDelta));
+          continue;
+        }
+        while (accumulator >= m_stepDelta) {
+          runStep();
+          accumulator -= m_stepDelta;
+        }
+      }
+    } catch (...) {
+      LOG_ERROR("Simulation thread stopped on an exception");
+      m_failure = std::current_exception();
+      m_failed.store(true, std::memory_order_release);
+    }
+  }
+
+  void SimulationThread::runStep() {
+    SimulationSnapshot &snapshot = m_snapshots.writeBuffer();
+    const size_t count           = m_bodies.size();
+    snapshot.previousX.assign(m_bodies.posX.begin(), m_bodies.posX.begin() + count);
+    snapshot.previousY.assign(m_bodies.posY.begin(), m_bodies.posY.begin() + count);
+
+    m_step(m_bodies, m_stepDelta);
+
+    snapshot.currentX.assign(m_bodies.posX.begin(), m_bodies.posX.begin() + count);
+    snapshot.currentY.assign(m_bodies.posY.begin(), m_bodies.posY.begin() + count);
+    snapshot.publishedAt = std::chrono::steady_clock::now();
+    snapshot.step        = m_stepCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    m_snapshots.publish();
+  }
+} // namespace kopi
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "BodyStore.h"
+#include "World.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace kopi {
+  // Body positions on either side of the most recent fixed step.
+  struct SimulationSnapshot {
+    std::vector<float> previousX;
+    std::vector<float> previousY;
+    std::vector<float> currentX;
+    std::vector<float> currentY;
+    std::chrono::steady_clock::time_point publishedAt{};
+    uint64_t step = 0;
+  };
+
+  // Runs a simulation on its own thread at a fixed timestep, decoupled from the frame rate. Wall
+  // clock time goes into an accumulator that is drained in whole steps, and every step publishes
+  // a snapshot through a TripleBuffer. The render thread interpolates between the two states of
+  // the newest snapshot, so it is drawn one step behind the simulation but never stutters.
+  class SimulationThread {
+  public:
+    using StepFunction = std::function<void(BodyStore &bodies, float dt)>;
+
+    // Steps bodies with step(bodies, stepDelta). Anything step touches belongs to the simulation
+    // thread until stop().
+    SimulationThread(BodyStore bodies, float stepDelta, StepFunction step);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread &)            = delete;
+    SimulationThread &operator=(const SimulationThread &) = delete;
+
+    void start();
+    void stop();
+
+    // Writes positions blended between the last two steps into the transforms of world's bodies,
+    // which must be the ones the simulation was loaded from. Rethrows on the caller if the
+    // simulation thread failed.
+    void interpolate(World &world);
+
+    uint64_t stepCount() const { return m_stepCount.load(std::memory_order_relaxed); }
+
+  private:
+    // after a stall at most this many steps are run to catch up, the rest of the time is dropped
+    static constexpr int MAX_CATCH_UP_STEPS = 8;
+
+    void threadLoop();
+    void runStep();
+
+    BodyStore m_bodies;
+    const float m_stepDelta;
+    StepFunction m_step;
+
+    TripleBuffer<SimulationSnapshot> m_snapshots;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_stepCount{0};
+    std::exception_ptr m_failure;
+    std::atomic<bool> m_failed{false};
+  };
+} // namespace kopi
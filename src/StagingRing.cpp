@@ -0,0 +1,230 @@
+#include "StagingRing.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace kopi {
+  StagingRing::StagingRing(EngineDevice &device, VkDeviceSize size)
+      : m_device(device), m_size(size) {
+    ASSERT_LOG(m_size % COPY_ALIGNMENT == 0,
+               "Staging ring size {} must be a multiple of {}",
+               m_size,
+               COPY_ALIGNMENT);
+    m_device.createBuffer(m_size,
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          m_buffer,
+                          m_memory);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = m_device.transferFamily();
+    poolInfo.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(m_device.device(), &poolInfo, nullptr, &m_commandPool) !=
+        VK_SUCCESS) {
+      LOG_ERROR("Failed to create upload command pool!");
+      throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue  = 0;
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(m_device.device(), &semaphoreInfo, nullptr, &m_timeline) !=
+        VK_SUCCESS) {
+      LOG_ERROR("Failed to create upload timeline semaphore!");
+      throw std::runtime_error("failed to create upload timeline semaphore!");
+    }
+  }
+
+  StagingRing::~StagingRing() {
+    wait();
+    vkDestroySemaphore(m_device.device(), m_timeline, nullptr);
+    vkDestroyCommandPool(m_device.device(), m_commandPool, nullptr);
+    m_device.destroyBuffer(m_buffer, m_memory);
+  }
+
+  UploadTicket StagingRing::upload(VkBuffer dst,
+                                   VkDeviceSize dstOffset,
+                                   const void *data,
+                                   VkDeviceSize size,
+                                   VkPipelineStageFlags dstStage) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+      const VkDeviceSize chunk  = std::min(size, m_size);
+      const VkDeviceSize offset = reserve(chunk);
+      memcpy(static_cast<char *>(m_memory.mapped) + offset, bytes, static_cast<size_t>(chunk));
+
+      // consecutive uploads to one buffer are usually adjacent in both, so they share a region
+      VkBufferCopy *last = m_pending.empty() ? nullptr : &m_pending.back().region;
+      if (last != nullptr && m_pending.back().dst == dst &&
+          last->srcOffset + last->size == offset && last->dstOffset + last->size == dstOffset) {
+        last->size += chunk;
+      } else {
+        m_pending.push_back({dst, {offset, dstOffset, chunk}});
+      }
+      m_bytesUploaded += chunk;
+
+      bytes += chunk;
+      dstOffset += chunk;
+      size -= chunk;
+    }
+    m_waitStages |= dstStage;
+    return {m_submitted + 1};
+  }
+
+  UploadTicket StagingRing::flush() {
+    if (m_pending.empty()) {
+      return {m_submitted};
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool        = m_commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    Submission submission{};
+    if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, &submission.commandBuffer) !=
+        VK_SUCCESS) {
+      LOG_ERROR("Failed to allocate upload command buffer!");
+      throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(submission.commandBuffer, &beginInfo);
+
+    // one vkCmdCopyBuffer per destination buffer
+    std::stable_sort(m_pending.begin(),
+                     m_pending.end(),
+                     [](const PendingCopy &a, const PendingCopy &b) { return a.dst < b.dst; });
+    std::vector<VkBufferCopy> regions;
+    for (size_t first = 0; first < m_pending.size();) {
+      regions.clear();
+      size_t last = first;
+      for (; last < m_pending.size() && m_pending[last].dst == m_pending[first].dst; last++) {
+        regions.push_back(m_pending[last].region);
+      }
+      vkCmdCopyBuffer(submission.commandBuffer,
+                      m_buffer,
+                      m_pending[first].dst,
+                      static_cast<uint32_t>(regions.size()),
+                      regions.data());
+      first = last;
+    }
+    // no barrier, the semaphore wait of whoever reads the data makes the writes visible to it
+    vkEndCommandBuffer(submission.commandBuffer);
+
+    submission.value = m_submitted + 1;
+    submission.end   = m_head;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues    = &submission.value;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext                = &timelineInfo;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &submission.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores    = &m_timeline;
+    if (vkQueueSubmit(m_device.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+      LOG_ERROR("Failed to submit uploads!");
+      throw std::runtime_error("failed to submit uploads!");
+    }
+
+    m_inFlight.push_back(submission);
+    m_pending.clear();
+    m_submitted = submission.value;
+    return {m_submitted};
+  }
+
+  bool StagingRing::isComplete(UploadTicket ticket) const {
+    return ticket.value <= m_submitted && completedValue() >= ticket.value;
+  }
+
+  void StagingRing::wait(UploadTicket ticket) {
+    if (ticket.value > m_submitted) {
+      flush();
+    }
+    waitForValue(ticket.value);
+    retire(false);
+  }
+
+  void StagingRing::wait() {
+    flush();
+    waitForValue(m_submitted);
+    retire(false);
+  }
+
+  TimelineWait StagingRing::pendingWait() const { return {m_timeline, m_submitted, m_waitStages}; }
+
+  VkDeviceSize StagingRing::reserve(VkDeviceSize size) {
+    const VkDeviceSize aligned = (size + COPY_ALIGNMENT - 1) & ~(COPY_ALIGNMENT - 1);
+    for (;;) {
+      if (m_head == m_tail) {
+        // nothing in use, start over at the front so the whole ring is available
+        m_head = m_tail = 0;
+      }
+      const VkDeviceSize offset = m_head % m_size;
+      // a reservation never wraps, the space up to the end is skipped instead
+      const VkDeviceSize skip = offset + aligned > m_size ? m_size - offset : 0;
+      if (m_head + skip + aligned - m_tail <= m_size) {
+        m_head += skip;
+        const VkDeviceSize start = m_head % m_size;
+        m_head += aligned;
+        return start;
+      }
+
+      retire(false);
+      if (m_head + skip + aligned - m_tail <= m_size) {
+        continue;
+      }
+      if (!m_pending.empty()) {
+        flush();
+      }
+      retire(true);
+    }
+  }
+
+  void StagingRing::retire(bool block) {
+    if (m_inFlight.empty()) {
+      return;
+    }
+    if (block) {
+      waitForValue(m_inFlight.front().value);
+    }
+    const uint64_t completed = completedValue();
+    while (!m_inFlight.empty() && m_inFlight.front().value <= completed) {
+      Submission &oldest = m_inFlight.front();
+      vkFreeCommandBuffers(m_device.device(), m_commandPool, 1, &oldest.commandBuffer);
+      m_tail = oldest.end;
+      m_inFlight.pop_front();
+    }
+  }
+
+  uint64_t StagingRing::completedValue() const {
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(m_device.device(), m_timeline, &value);
+    return value;
+  }
+
+  void StagingRing::waitForValue(uint64_t value) {
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores    = &m_timeline;
+    waitInfo.pValues        = &value;
+    vkWaitSemaphores(m_device.device(), &waitInfo, UINT64_MAX);
+  }
+} // namespace kopi
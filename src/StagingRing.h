@@ -0,0 +1,102 @@
+#pragma once
+
+#include "EngineDevice.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace kopi {
+  // Identifies the flush an upload goes out with. Completion can be polled or waited on, and a
+  // frame that reads the data waits for it on the GPU through pendingWait.
+  struct UploadTicket {
+    uint64_t value = 0; // timeline value signalled when the flush has landed, 0 needs nothing
+  };
+
+  // Uploads to device local buffers through one persistently mapped, host visible ring. upload
+  // copies the data into the ring straight away and queues a copy region; flush records every
+  // queued region into a single command buffer and submits it to the transfer queue, which is a
+  // dedicated copy engine where the device has one, so loading overlaps rendering instead of
+  // stalling it. Each flush signals the next value of a timeline semaphore: the ring space of a
+  // flush is reclaimed once its value is reached, so uploads only block when the GPU is a full
+  // ring behind, and nothing waits for the whole queue to go idle.
+  //
+  // Submissions that read uploaded data must wait for pendingWait, Renderer::addTimelineWait does
+  // that for a frame. Not thread safe.
+  class StagingRing {
+  public:
+    static constexpr VkDeviceSize DEFAULT_SIZE = 8ull << 20;
+
+    explicit StagingRing(EngineDevice &device, VkDeviceSize size = DEFAULT_SIZE);
+    ~StagingRing();
+
+    StagingRing(const StagingRing &)            = delete;
+    StagingRing &operator=(const StagingRing &) = delete;
+
+    // Copies size bytes of data into the ring for dst, at dstOffset, on the next flush. dstStage
+    // is where dst is used first, it becomes part of pendingWait. Uploads larger than the ring are
+    // split, flushing whenever it fills up, and the ticket is the one of the last part.
+    UploadTicket upload(VkBuffer dst,
+                        VkDeviceSize dstOffset,
+                        const void *data,
+                        VkDeviceSize size,
+                        VkPipelineStageFlags dstStage);
+    // Submits the queued copies without waiting for them. Returns the ticket of everything
+    // uploaded so far.
+    UploadTicket flush();
+
+    bool isComplete(UploadTicket ticket) const;
+    // Blocks until ticket has completed, flushing first if it has not been submitted yet.
+    void wait(UploadTicket ticket);
+    // Flushes and blocks until every upload has completed.
+    void wait();
+
+    // Everything flushed so far, for the next submission that reads uploaded data.
+    TimelineWait pendingWait() const;
+
+    VkDeviceSize size() const { return m_size; }
+    uint64_t submitCount() const { return m_submitted; }
+    uint64_t bytesUploaded() const { return m_bytesUploaded; }
+
+  private:
+    // copies start on this boundary, enough for any optimalBufferCopyOffsetAlignment in practice
+    static constexpr VkDeviceSize COPY_ALIGNMENT = 16;
+
+    struct PendingCopy {
+      VkBuffer dst;
+      VkBufferCopy region;
+    };
+
+    struct Submission {
+      VkCommandBuffer commandBuffer;
+      uint64_t value;
+      uint64_t end; // ring position past the last byte the submission reads
+    };
+
+    // Returns the ring offset of size free, contiguous bytes, retiring or flushing as needed.
+    VkDeviceSize reserve(VkDeviceSize size);
+    // Reclaims the space of completed submissions, blocking on the oldest one when block is set.
+    void retire(bool block);
+    uint64_t completedValue() const;
+    void waitForValue(uint64_t value);
+
+    EngineDevice &m_device;
+    VkDeviceSize m_size;
+    VkBuffer m_buffer           = VK_NULL_HANDLE;
+    MemoryAllocation m_memory   = {};
+    VkCommandPool m_commandPool = VK_NULL_HANDLE; // on the transfer family
+    VkSemaphore m_timeline      = VK_NULL_HANDLE;
+
+    // Monotonic byte positions, the ring offset is position % m_size. Everything in
+    // [m_tail, m_head) is still read by a submission or by the pending copies.
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+
+    std::vector<PendingCopy> m_pending;
+    std::deque<Submission> m_inFlight;
+    uint64_t m_submitted              = 0; // timeline value of the latest flush
+    VkPipelineStageFlags m_waitStages = 0; // every dstStage seen, for pendingWait
+    uint64_t m_bytesUploaded          = 0;
+  };
+} // namespace kopi
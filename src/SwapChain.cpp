@@ -44,8 +44,7 @@ namespace kopi {
 
     for (int i = 0; i < depthImages.size(); i++) {
       vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-      vkDestroyImage(device.device(), depthImages[i], nullptr);
-      vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+      device.destroyImage(depthImages[i], depthImageMemorys[i]);
     }
 
     for (auto framebuffer : swapChainFramebuffers) {
@@ -80,7 +79,9 @@ namespace kopi {
     return result;
   }
 
-  VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex) {
+  VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
+                                           uint32_t *imageIndex,
+                                           const std::vector<TimelineWait> &timelineWaits) {
     if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
       vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
     }
@@ -89,11 +90,26 @@ namespace kopi {
     VkSubmitInfo submitInfo = {};
     submitInfo.sType        = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[]      = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount     = 1;
-    submitInfo.pWaitSemaphores        = waitSemaphores;
-    submitInfo.pWaitDstStageMask      = waitStages;
+    std::vector<VkSemaphore> waitSemaphores      = {imageAvailableSemaphores[currentFrame]};
+    std::vector<VkPipelineStageFlags> waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    // the value of the binary image semaphore is ignored
+    std::vector<uint64_t> waitValues = {0};
+    for (const auto &wait : timelineWaits) {
+      waitSemaphores.push_back(wait.semaphore);
+      waitStages.push_back(wait.stages);
+      waitValues.push_back(wait.value);
+    }
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores    = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask  = waitStages.data();
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType                   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues    = waitValues.data();
+    if (!timelineWaits.empty()) {
+      submitInfo.pNext = &timelineInfo;
+    }
 
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers    = buffers;
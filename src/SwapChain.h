@@ -37,7 +37,10 @@ namespace kopi {
     VkFormat findDepthFormat();
 
     VkResult acquireNextImage(uint32_t *imageIndex);
-    VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+    // timelineWaits are added to the submission next to the wait for the acquired image
+    VkResult submitCommandBuffers(const VkCommandBuffer *buffers,
+                                  uint32_t *imageIndex,
+                                  const std::vector<TimelineWait> &timelineWaits = {});
 
     bool compareSwapFormats(const SwapChain &swapChain) const {
       return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -68,7 +71,7 @@ namespace kopi {
     VkRenderPass renderPass;
 
     std::vector<VkImage> depthImages;
-    std::vector<VkDeviceMemory> depthImageMemorys;
+    std::vector<MemoryAllocation> depthImageMemorys;
     std::vector<VkImageView> depthImageViews;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
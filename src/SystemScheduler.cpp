@@ -0,0 +1,72 @@
+#include "SystemScheduler.h"
+
+#include <utility>
+
+namespace kopi {
+  void SystemScheduler::add(std::string name,
+                            std::initializer_list<SystemAccess> accesses,
+                            SystemFunction fn) {
+    System system{};
+    system.name     = std::move(name);
+    system.accesses = accesses;
+    system.fn       = std::move(fn);
+    m_systems.push_back(std::move(system));
+  }
+
+  void SystemScheduler::run(World &world, JobSystem *jobSystem) {
+    // archetypes only appear when entities are created, which never happens mid frame, so the
+    // graph is rebuilt here and stays valid until the next run
+    const size_t archetypeCount = world.archetypeCount();
+    for (auto &system : m_systems) {
+      system.reads.assign(archetypeCount, 0);
+      system.writes.assign(archetypeCount, 0);
+      for (size_t archetype = 0; archetype < archetypeCount; archetype++) {
+        const ComponentMask mask = world.archetypeMask(archetype);
+        for (const auto &access : system.accesses) {
+          if ((mask & access.query) == access.query) {
+            system.reads[archetype] |= access.reads;
+            system.writes[archetype] |= access.writes;
+          }
+        }
+      }
+    }
+
+    for (size_t i = 0; i < m_systems.size(); i++) {
+      m_systems[i].dependencies.clear();
+      for (size_t j = 0; j < i; j++) {
+        if (conflicts(m_systems[j], m_systems[i])) {
+          m_systems[i].dependencies.push_back(j);
+        }
+      }
+    }
+
+    if (jobSystem == nullptr) {
+      for (auto &system : m_systems) {
+        system.fn(world);
+      }
+      return;
+    }
+
+    m_jobs.clear();
+    std::vector<JobHandle> dependencies;
+    for (auto &system : m_systems) {
+      dependencies.clear();
+      for (size_t dependency : system.dependencies) {
+        dependencies.push_back(m_jobs[dependency]);
+      }
+      m_jobs.push_back(jobSystem->schedule([&] { system.fn(world); }, dependencies));
+    }
+    jobSystem->wait(m_jobs);
+  }
+
+  bool SystemScheduler::conflicts(const System &a, const System &b) {
+    for (size_t archetype = 0; archetype < a.reads.size(); archetype++) {
+      const ComponentMask touchedA = a.reads[archetype] | a.writes[archetype];
+      const ComponentMask touchedB = b.reads[archetype] | b.writes[archetype];
+      if ((a.writes[archetype] & touchedB) != 0 || (b.writes[archetype] & touchedA) != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+} // namespace kopi
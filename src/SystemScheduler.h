@@ -0,0 +1,63 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "World.h"
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace kopi {
+  // Components a system touches on every archetype holding all of the components in query.
+  struct SystemAccess {
+    ComponentMask query  = 0;
+    ComponentMask reads  = 0;
+    ComponentMask writes = 0;
+  };
+
+  // Runs a frame's systems as a graph of jobs. Each system declares what it reads and writes, and
+  // before every run the declarations are resolved against the World's archetypes: two systems
+  // conflict when one writes a component the other touches on an archetype both of them match.
+  // A system waits for every earlier conflicting one, anything else runs alongside it, so with no
+  // conflicts at all the frame is as parallel as the JobSystem allows and with conflicts
+  // everywhere it degenerates to registration order.
+  //
+  // Systems must not create or destroy entities, that would change the archetypes the graph was
+  // built from.
+  class SystemScheduler {
+  public:
+    using SystemFunction = std::function<void(World &world)>;
+
+    // Systems are ordered by registration wherever they conflict.
+    void add(std::string name, std::initializer_list<SystemAccess> accesses, SystemFunction fn);
+
+    // Builds the graph for the current archetypes and runs it, on the calling thread in
+    // registration order when jobSystem is null.
+    void run(World &world, JobSystem *jobSystem);
+
+    size_t systemCount() const { return m_systems.size(); }
+    const std::string &name(size_t system) const { return m_systems[system].name; }
+    // earlier systems the last run made system wait for
+    const std::vector<size_t> &dependencies(size_t system) const {
+      return m_systems[system].dependencies;
+    }
+
+  private:
+    struct System {
+      std::string name;
+      std::vector<SystemAccess> accesses;
+      SystemFunction fn;
+      // per archetype of the World, resolved by run
+      std::vector<ComponentMask> reads;
+      std::vector<ComponentMask> writes;
+      std::vector<size_t> dependencies;
+    };
+
+    static bool conflicts(const System &a, const System &b);
+
+    std::vector<System> m_systems;
+    std::vector<JobHandle> m_jobs;
+  };
+} // namespace kopi
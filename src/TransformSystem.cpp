@@ -0,0 +1,170 @@
+#include "TransformSystem.h"
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace kopi {
+  // The angle is reduced to r in [-pi/4, pi/4] by subtracting the nearest multiple j of pi/2, in
+  // three parts so the product stays exact, then both polynomials are evaluated on r and the
+  // quadrant j picks which one is the sine and their signs.
+  static constexpr float TWO_OVER_PI = 0.636619772f;
+  static constexpr float PI_OVER_2_A = 1.5703125f;
+  static constexpr float PI_OVER_2_B = 4.837512969970703125e-4f;
+  static constexpr float PI_OVER_2_C = 7.54978995489188216e-8f;
+
+  // minimax coefficients on [-pi/4, pi/4]
+  static constexpr float SIN_1 = -1.6666654611e-1f;
+  static constexpr float SIN_2 = 8.3321608736e-3f;
+  static constexpr float SIN_3 = -1.9515295891e-4f;
+  static constexpr float COS_1 = 4.166664568298827e-2f;
+  static constexpr float COS_2 = -1.388731625493765e-3f;
+  static constexpr float COS_3 = 2.443315711809948e-5f;
+
+  // dirty transforms per job, enough that scheduling is noise next to the trig
+  static constexpr size_t TRANSFORM_GRAIN = 4096;
+
+  static void sinCosScalar(float angle, float *sine, float *cosine) {
+    const float quadrant = std::nearbyint(angle * TWO_OVER_PI);
+    const int32_t j      = static_cast<int32_t>(quadrant);
+    float r              = angle - quadrant * PI_OVER_2_A;
+    r                    = r - quadrant * PI_OVER_2_B;
+    r                    = r - quadrant * PI_OVER_2_C;
+
+    const float z = r * r;
+    const float s = r + r * z * (SIN_1 + z * (SIN_2 + z * SIN_3));
+    const float c = 1.0f - 0.5f * z + z * z * (COS_1 + z * (COS_2 + z * COS_3));
+
+    const float swappedSine   = (j & 1) ? c : s;
+    const float swappedCosine = (j & 1) ? s : c;
+    *sine                     = (j & 2) ? -swappedSine : swappedSine;
+    *cosine                   = ((j + 1) & 2) ? -swappedCosine : swappedCosine;
+  }
+
+#if defined(__AVX2__) && defined(__FMA__)
+  static constexpr size_t LANES = 8;
+
+  static void sinCosBlock(const float *angle, float *sine, float *cosine) {
+    const __m256 x        = _mm256_loadu_ps(angle);
+    const __m256i j       = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+    const __m256 quadrant = _mm256_cvtepi32_ps(j);
+    __m256 r              = _mm256_fnmadd_ps(quadrant, _mm256_set1_ps(PI_OVER_2_A), x);
+    r                     = _mm256_fnmadd_ps(quadrant, _mm256_set1_ps(PI_OVER_2_B), r);
+    r                     = _mm256_fnmadd_ps(quadrant, _mm256_set1_ps(PI_OVER_2_C), r);
+
+    const __m256 z = _mm256_mul_ps(r, r);
+    __m256 s       = _mm256_fmadd_ps(z, _mm256_set1_ps(SIN_3), _mm256_set1_ps(SIN_2));
+    s              = _mm256_fmadd_ps(z, s, _mm256_set1_ps(SIN_1));
+    s              = _mm256_fmadd_ps(_mm256_mul_ps(r, z), s, r);
+    __m256 c       = _mm256_fmadd_ps(z, _mm256_set1_ps(COS_3), _mm256_set1_ps(COS_2));
+    c              = _mm256_fmadd_ps(z, c, _mm256_set1_ps(COS_1));
+    c              = _mm256_fmadd_ps(_mm256_mul_ps(z, z),
+                        c,
+                        _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, _mm256_set1_ps(1.0f)));
+
+    // odd quadrants swap the two, bit 1 of j and of j + 1 is moved onto the sign bit
+    const __m256i one  = _mm256_set1_epi32(1);
+    const __m256i two  = _mm256_set1_epi32(2);
+    const __m256 swap  = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, one), one));
+    const __m256 sSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, two), 30));
+    const __m256 cSign = _mm256_castsi256_ps(
+        _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(j, one), two), 30));
+
+    _mm256_storeu_ps(sine, _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sSign));
+    _mm256_storeu_ps(cosine, _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cSign));
+  }
+#elif defined(__SSE2__)
+  static constexpr size_t LANES = 4;
+
+  static void sinCosBlock(const float *angle, float *sine, float *cosine) {
+    const __m128 x        = _mm_loadu_ps(angle);
+    const __m128i j       = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+    const __m128 quadrant = _mm_cvtepi32_ps(j);
+    __m128 r              = _mm_sub_ps(x, _mm_mul_ps(quadrant, _mm_set1_ps(PI_OVER_2_A)));
+    r                     = _mm_sub_ps(r, _mm_mul_ps(quadrant, _mm_set1_ps(PI_OVER_2_B)));
+    r                     = _mm_sub_ps(r, _mm_mul_ps(quadrant, _mm_set1_ps(PI_OVER_2_C)));
+
+    const __m128 z = _mm_mul_ps(r, r);
+    __m128 s       = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(SIN_3)), _mm_set1_ps(SIN_2));
+    s              = _mm_add_ps(_mm_mul_ps(z, s), _mm_set1_ps(SIN_1));
+    s              = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(r, z), s), r);
+    __m128 c       = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(COS_3)), _mm_set1_ps(COS_2));
+    c              = _mm_add_ps(_mm_mul_ps(z, c), _mm_set1_ps(COS_1));
+    c              = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(z, z), c),
+                   _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)));
+
+    // no blendv before SSE4.1, the swap is done with masks
+    const __m128i one  = _mm_set1_epi32(1);
+    const __m128i two  = _mm_set1_epi32(2);
+    const __m128 swap  = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, one), one));
+    const __m128 sSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, two), 30));
+    const __m128 cSign =
+        _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, one), two), 30));
+
+    const __m128 swappedSine   = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    const __m128 swappedCosine = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    _mm_storeu_ps(sine, _mm_xor_ps(swappedSine, sSign));
+    _mm_storeu_ps(cosine, _mm_xor_ps(swappedCosine, cSign));
+  }
+#else
+  static constexpr size_t LANES = 1;
+
+  static void sinCosBlock(const float *angle, float *sine, float *cosine) {
+    sinCosScalar(*angle, sine, cosine);
+  }
+#endif
+
+  void sinCos(const float *angle, size_t count, float *sine, float *cosine) {
+    const size_t vectorCount = count - count % LANES;
+    for (size_t i = 0; i < vectorCount; i += LANES) {
+      sinCosBlock(angle + i, sine + i, cosine + i);
+    }
+    for (size_t i = vectorCount; i < count; i++) {
+      sinCosScalar(angle[i], sine + i, cosine + i);
+    }
+  }
+
+  void TransformSystem::update(World &world) {
+    m_dirty.clear();
+    m_angle.clear();
+    for (auto chunk : world.view<Transform2dComponent>()) {
+      if ((chunk.mask() & query) != query) {
+        continue;
+      }
+      for (auto &transform : chunk.get<Transform2dComponent>()) {
+        if (transform.dirty) {
+          m_dirty.push_back(&transform);
+          m_angle.push_back(transform.rotation);
+        }
+      }
+    }
+
+    const size_t count = m_dirty.size();
+    m_sine.resize(count);
+    m_cosine.resize(count);
+
+    // rotation * scale, written out column by column
+    auto computeMatrices = [&](size_t begin, size_t end) {
+      sinCos(m_angle.data() + begin, end - begin, m_sine.data() + begin, m_cosine.data() + begin);
+      for (size_t k = begin; k < end; k++) {
+        Transform2dComponent &transform = *m_dirty[k];
+        const float s                   = m_sine[k];
+        const float c                   = m_cosine[k];
+        transform.matrix = {
+            {c * transform.scale.x,  s * transform.scale.x},
+            {-s * transform.scale.y, c * transform.scale.y}
+        };
+        transform.dirty = false;
+      }
+    };
+    if (jobSystem != nullptr) {
+      jobSystem->parallelFor(count, TRANSFORM_GRAIN, computeMatrices);
+    } else {
+      computeMatrices(0, count);
+    }
+    m_matrixUpdates += count;
+  }
+} // namespace kopi
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "World.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace kopi {
+  // sin and cos of every angle, vectorised with AVX2 or SSE2 when the build enables them. Accurate
+  // to about 1e-7 for angles within a few thousand radians of zero.
+  void sinCos(const float *angle, size_t count, float *sine, float *cosine);
+
+  // Keeps Transform2dComponent::matrix in step with rotation and scale. Only transforms flagged
+  // dirty are recomputed, their angles are gathered into one array so sinCos runs over all of them
+  // in a single pass, and clean ones are only read to check the flag.
+  class TransformSystem {
+  public:
+    // optional, matrices are computed on the calling thread when null
+    JobSystem *jobSystem = nullptr;
+    // Only archetypes holding all of these are updated. Instances with queries that match
+    // different archetypes touch disjoint transforms and can be scheduled side by side.
+    ComponentMask query = componentMask<Transform2dComponent>();
+
+    void update(World &world);
+
+    // matrices recomputed since construction
+    size_t matrixUpdates() const { return m_matrixUpdates; }
+
+  private:
+    std::vector<Transform2dComponent *> m_dirty;
+    std::vector<float> m_angle;
+    std::vector<float> m_sine;
+    std::vector<float> m_cosine;
+    size_t m_matrixUpdates = 0;
+  };
+} // namespace kopi
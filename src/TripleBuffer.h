@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace kopi {
+  // Lock-free single producer, single consumer hand-off of the newest value. The producer fills
+  // writeBuffer() and publishes it, the consumer acquires the latest published value and reads it
+  // until it acquires again. The third buffer sits in the middle, so neither side ever waits on
+  // the other and a published value is never torn. Buffers are recycled, so the producer must
+  // rewrite every field it publishes.
+  template <typename T>
+  class TripleBuffer {
+  public:
+    T &writeBuffer() { return m_buffers[m_writeIndex]; }
+
+    void publish() {
+      uint8_t previous = m_middle.exchange(m_writeIndex | FRESH, std::memory_order_acq_rel);
+      m_writeIndex     = previous & INDEX_MASK;
+    }
+
+    // Swaps in the newest published value, returns false if nothing was published since the last
+    // call, in which case readBuffer() keeps its previous contents.
+    bool acquire() {
+      if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+        return false;
+      }
+      uint8_t previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+      m_readIndex      = previous & INDEX_MASK;
+      return true;
+    }
+
+    const T &readBuffer() const { return m_buffers[m_readIndex]; }
+
+  private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH      = 0x4;
+
+    std::array<T, 3> m_buffers{};
+    uint8_t m_writeIndex = 0;
+    std::atomic<uint8_t> m_middle{1};
+    uint8_t m_readIndex = 2;
+  };
+} // namespace kopi
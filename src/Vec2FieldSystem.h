@@ -0,0 +1,334 @@
+#pragma once
+
+#include "BodyStore.h"
+#include "JobSystem.h"
+#include "NBodyKernel.h"
+#include "World.h"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace kopi {
+  class Vec2FieldSystem {
+  public:
+    // optional, samples are shaded on the calling thread when null
+    JobSystem *jobSystem = nullptr;
+
+    // Lazy mode bounds how far the field of each tile of samples may have drifted since it was
+    // last shaded, from how far the bodies moved each update in between, and only re-evaluates
+    // tiles where that exceeds lazyTolerance times the weakest field in the tile, so the arrows
+    // stay within about lazyTolerance radians. When more than three quarters of the tiles are out
+    // of date, or bodies were added, removed or changed mass, everything is recomputed.
+    //
+    // Sample positions and masses are read when the number of samples changes and are assumed to
+    // stay put otherwise, in either mode.
+    bool lazyUpdates    = false;
+    float lazyTolerance = 0.02f;
+
+    // tiles of FIELD_TILE samples evaluated since construction
+    uint64_t tileEvaluations() const { return m_tileEvaluations; }
+
+    // Shades every entity with a FieldSampleComponent by the field of every entity with a
+    // RigidBody2dComponent.
+    void update(float strengthGravity, World &world) {
+      SampleView samples =
+          world.view<Transform2dComponent, ColourComponent, FieldSampleComponent>();
+      const size_t sampleCount = samples.size();
+      if (samples.version() != m_sampleVersion) {
+        buildTiles(samples);
+        m_sampleVersion = samples.version();
+      }
+      const size_t tileCount = m_sampleX.size() / FIELD_TILE;
+
+      // a body created or destroyed reorders the rows, so the recorded positions no longer line up
+      m_bodies.loadFrom(world);
+      const size_t bodyCount     = m_bodies.size();
+      const uint64_t bodyVersion =
+          world.view<Transform2dComponent, RigidBody2dComponent>().version();
+      if (!lazyUpdates || bodyVersion != m_bodyVersion || !markStaleTiles(strengthGravity)) {
+        m_staleTiles.resize(tileCount);
+        for (size_t tile = 0; tile < tileCount; tile++) {
+          m_staleTiles[tile] = static_cast<uint32_t>(tile);
+        }
+        if (lazyUpdates) {
+          m_bodyMasses.assign(m_bodies.mass.begin(), m_bodies.mass.begin() + bodyCount);
+          m_bodyVersion = bodyVersion;
+        }
+      }
+      m_tileEvaluations += m_staleTiles.size();
+      m_previousBodies.resize(bodyCount);
+      for (size_t b = 0; b < bodyCount; b++) {
+        m_previousBodies[b] = {m_bodies.posX[b], m_bodies.posY[b]};
+      }
+
+      // samples sit in tile order in structure-of-arrays form so fieldSamples can stream them,
+      // the padded tail is computed and thrown away
+      auto fieldTile = [&](size_t k) {
+        const size_t tile  = m_staleTiles[k];
+        const size_t begin = tile * FIELD_TILE;
+        const size_t end   = begin + FIELD_TILE;
+        const size_t last  = std::min(end, sampleCount);
+        m_tileDrift[tile]  = 0.0f;
+
+        fieldSamples(m_sampleX.data() + begin,
+                     m_sampleY.data() + begin,
+                     FIELD_TILE,
+                     m_bodies.posX.data(),
+                     m_bodies.posY.data(),
+                     m_bodies.mass.data(),
+                     m_bodies.paddedSize(),
+                     strengthGravity,
+                     m_netX.data() + begin,
+                     m_netY.data() + begin,
+                     m_magnitude.data() + begin);
+
+        float weakest = std::numeric_limits<float>::max();
+        for (size_t i = begin; i < last; i++) {
+          weakest = std::min(weakest, m_netX[i] * m_netX[i] + m_netY[i] * m_netY[i]);
+        }
+        m_tileField[tile] = std::sqrt(weakest);
+
+        // the curves reuse the arrays in place for scale, rotation and the colour parameter,
+        // which also keeps them around for tiles that are skipped next time
+        for (size_t i = begin; i < end; i++) {
+          float dirX  = m_sampleMass[i] * m_netX[i];
+          float dirY  = m_sampleMass[i] * m_netY[i];
+          float mag01 = std::clamp(
+              fastLog(std::sqrt(dirX * dirX + dirY * dirY) + 1.0f) / 3.0f, 0.0f, 1.0f);
+          m_netX[i]      = 0.005f + 0.045f * mag01;
+          m_netY[i]      = fastAtan2(dirY, dirX);
+          m_magnitude[i] = std::clamp(fastLog(m_magnitude[i] + 1.0f) / 3.0f, 0.0f, 1.0f);
+        }
+      };
+
+      if (jobSystem != nullptr) {
+        jobSystem->parallelFor(m_staleTiles.size(), 1, [&](size_t begin, size_t end) {
+          for (size_t k = begin; k < end; k++) {
+            fieldTile(k);
+          }
+        });
+      } else {
+        for (size_t k = 0; k < m_staleTiles.size(); k++) {
+          fieldTile(k);
+        }
+      }
+
+      // Gradient (blue→green→red) by acceleration only
+      const glm::vec3 c0 = {0.0f, 0.1f, 0.8f};
+      const glm::vec3 c1 = {0.0f, 1.0f, 0.0f};
+      const glm::vec3 c2 = {1.0f, 0.0f, 0.0f};
+      size_t j           = 0;
+      for (auto chunk : samples) {
+        auto transforms = chunk.get<Transform2dComponent>();
+        auto colours    = chunk.get<ColourComponent>();
+        for (size_t row = 0; row < chunk.size(); row++, j++) {
+          const size_t i                  = m_slots[j];
+          const float a01                 = m_magnitude[i];
+          Transform2dComponent &transform = transforms[row];
+          // arrows of tiles that were not recomputed keep their matrix
+          if (transform.scale.x != m_netX[i] || transform.rotation != m_netY[i]) {
+            transform.scale.x  = m_netX[i];
+            transform.rotation = m_netY[i];
+            transform.dirty    = true;
+          }
+          colours[row].colour =
+              (a01 < 0.5f) ? glm::mix(c0, c1, a01 * 2.0f) : glm::mix(c1, c2, (a01 - 0.5f) * 2.0f);
+        }
+      }
+    }
+
+  private:
+    using SampleView = View<Transform2dComponent, ColourComponent, FieldSampleComponent>;
+
+    // samples per tile and per work item
+    static constexpr size_t FIELD_TILE = 16;
+    static_assert(FIELD_TILE % BodyStore::PADDING == 0, "Field tiles must not split SIMD lanes");
+
+    // Copies sample positions and masses out in the order of a Morton curve, so consecutive runs
+    // of FIELD_TILE cover compact patches of the plane, which keeps the per-tile bounds in
+    // markStaleTiles tight.
+    void buildTiles(const SampleView &samples) {
+      const size_t sampleCount = samples.size();
+      const size_t paddedCount = (sampleCount + FIELD_TILE - 1) / FIELD_TILE * FIELD_TILE;
+      const size_t tileCount   = paddedCount / FIELD_TILE;
+      for (auto *array : {&m_sampleX, &m_sampleY, &m_sampleMass, &m_netX, &m_netY, &m_magnitude}) {
+        array->assign(paddedCount, 0.0f);
+      }
+      m_tileMin.assign(tileCount, glm::vec2{std::numeric_limits<float>::max()});
+      m_tileMax.assign(tileCount, glm::vec2{-std::numeric_limits<float>::max()});
+      m_tileField.assign(tileCount, 0.0f);
+      m_tileDrift.assign(tileCount, 0.0f);
+
+      std::vector<glm::vec2> positions;
+      std::vector<float> masses;
+      positions.reserve(sampleCount);
+      masses.reserve(sampleCount);
+      for (auto chunk : samples) {
+        for (size_t row = 0; row < chunk.size(); row++) {
+          positions.push_back(chunk.get<Transform2dComponent>()[row].translation);
+          masses.push_back(chunk.get<FieldSampleComponent>()[row].mass);
+        }
+      }
+
+      glm::vec2 minPos{std::numeric_limits<float>::max()};
+      glm::vec2 maxPos{-std::numeric_limits<float>::max()};
+      for (const auto &position : positions) {
+        minPos = glm::min(minPos, position);
+        maxPos = glm::max(maxPos, position);
+      }
+      const glm::vec2 extent = glm::max(maxPos - minPos, glm::vec2{1e-6f});
+
+      std::vector<uint32_t> codes(sampleCount);
+      std::vector<uint32_t> order(sampleCount);
+      for (size_t j = 0; j < sampleCount; j++) {
+        glm::vec2 unit = (positions[j] - minPos) / extent;
+        codes[j]       = spreadBits(static_cast<uint32_t>(unit.x * 65535.0f)) |
+                   (spreadBits(static_cast<uint32_t>(unit.y * 65535.0f)) << 1);
+        order[j] = static_cast<uint32_t>(j);
+      }
+      std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return codes[a] < codes[b];
+      });
+
+      m_slots.resize(sampleCount);
+      for (size_t i = 0; i < sampleCount; i++) {
+        const size_t j    = order[i];
+        const size_t tile = i / FIELD_TILE;
+        m_slots[j]        = static_cast<uint32_t>(i);
+        m_sampleX[i]      = positions[j].x;
+        m_sampleY[i]      = positions[j].y;
+        m_sampleMass[i]   = masses[j];
+        m_tileMin[tile]   = glm::min(m_tileMin[tile], positions[j]);
+        m_tileMax[tile]   = glm::max(m_tileMax[tile], positions[j]);
+      }
+    }
+
+    // spaces the low 16 bits of value out to the even bits
+    static uint32_t spreadBits(uint32_t value) {
+      value &= 0x0000ffffu;
+      value = (value | (value << 8)) & 0x00ff00ffu;
+      value = (value | (value << 4)) & 0x0f0f0f0fu;
+      value = (value | (value << 2)) & 0x33333333u;
+      value = (value | (value << 1)) & 0x55555555u;
+      return value;
+    }
+
+    // Collects the tiles whose field may have drifted too far into m_staleTiles. A body of mass
+    // m displaced by delta changes the acceleration anywhere at least r away from the segment it
+    // moved along by at most 2 G m delta / r^3. Each tile adds that up over the bodies that moved
+    // since the previous update, on top of what it gathered in earlier updates since it was
+    // shaded, so only one set of old positions is kept however many tiles there are. Returns
+    // false when a full recompute is due instead.
+    bool markStaleTiles(float strength) {
+      const size_t bodyCount = m_bodies.size();
+      const size_t tileCount = m_tileField.size();
+      if (m_bodyMasses.size() != bodyCount || m_previousBodies.size() != bodyCount) {
+        return false;
+      }
+      for (size_t b = 0; b < bodyCount; b++) {
+        if (m_bodies.mass[b] != m_bodyMasses[b]) {
+          return false;
+        }
+      }
+
+      m_staleTiles.clear();
+      for (size_t tile = 0; tile < tileCount; tile++) {
+        auto distanceToTile = [&](glm::vec2 point) {
+          return glm::length(glm::max(glm::max(m_tileMin[tile] - point, point - m_tileMax[tile]),
+                                      glm::vec2{0.0f}));
+        };
+
+        const float allowed = lazyTolerance * m_tileField[tile];
+        float &drift        = m_tileDrift[tile];
+        for (size_t b = 0; b < bodyCount && drift <= allowed; b++) {
+          const glm::vec2 previous = m_previousBodies[b];
+          const glm::vec2 current  = {m_bodies.posX[b], m_bodies.posY[b]};
+          const float delta        = glm::length(current - previous);
+          if (delta == 0.0f) {
+            continue;
+          }
+          const float clearance =
+              std::max(distanceToTile(previous), distanceToTile(current)) - delta;
+          drift += clearance > 0.0f ? 2.0f * strength * m_bodyMasses[b] * delta /
+                                          (clearance * clearance * clearance)
+                                    : std::numeric_limits<float>::infinity();
+        }
+        if (drift > allowed) {
+          m_staleTiles.push_back(static_cast<uint32_t>(tile));
+          if (4 * m_staleTiles.size() > 3 * tileCount) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    // Natural log for x >= 1, range reduced to [sqrt(1/2), sqrt(2)) and finished with the atanh
+    // series, ~1e-7 relative. Branch free so the shading loop vectorises.
+    static float fastLog(float x) {
+      uint32_t bits;
+      std::memcpy(&bits, &x, sizeof(bits));
+      int32_t exponent = static_cast<int32_t>(bits >> 23) - 127;
+      bits             = (bits & 0x007fffffu) | 0x3f800000u;
+      float mantissa;
+      std::memcpy(&mantissa, &bits, sizeof(mantissa));
+      const bool high = mantissa > glm::root_two<float>();
+      mantissa        = high ? 0.5f * mantissa : mantissa;
+      exponent += high ? 1 : 0;
+
+      const float t  = (mantissa - 1.0f) / (mantissa + 1.0f);
+      const float t2 = t * t;
+      const float series =
+          2.0f * t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f))));
+      return static_cast<float>(exponent) * glm::ln_two<float>() + series;
+    }
+
+    // atan2 to ~2e-4 rad (0.01 degrees) with a polynomial on [0, 1], folded out to the full circle
+    static float fastAtan2(float y, float x) {
+      const float absX    = std::fabs(x);
+      const float absY    = std::fabs(y);
+      const float largest = std::max(absX, absY);
+      const float a       = largest > 0.0f ? std::min(absX, absY) / largest : 0.0f;
+      const float s       = a * a;
+      float angle = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+      angle       = absY > absX ? glm::half_pi<float>() - angle : angle;
+      angle       = x < 0.0f ? glm::pi<float>() - angle : angle;
+      return y < 0.0f ? -angle : angle;
+    }
+
+    BodyStore m_bodies;
+    std::vector<uint32_t> m_slots; // tile order position of each sample, in view order
+    uint64_t m_sampleVersion = UINT64_MAX; // view version the tiles were built from
+    // per sample, in tile order
+    AlignedFloats m_sampleX;
+    AlignedFloats m_sampleY;
+    AlignedFloats m_sampleMass;
+    AlignedFloats m_netX;
+    AlignedFloats m_netY;
+    AlignedFloats m_magnitude;
+
+    // per tile
+    std::vector<glm::vec2> m_tileMin;
+    std::vector<glm::vec2> m_tileMax;
+    std::vector<float> m_tileField; // weakest net acceleration when last shaded
+    std::vector<float> m_tileDrift; // bound on how far it has changed since
+    std::vector<uint32_t> m_staleTiles;
+    // body positions and masses at the previous update
+    std::vector<glm::vec2> m_previousBodies;
+    std::vector<float> m_bodyMasses;
+    uint64_t m_bodyVersion = UINT64_MAX;
+    uint64_t m_tileEvaluations = 0;
+  };
+
+} // namespace kopi
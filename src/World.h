@@ -0,0 +1,313 @@
+#pragma once
+
+#include "Components.h"
+#include "Log.h"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace kopi {
+  // Handle to an entity. index names a slot in the World, generation counts how often that slot
+  // has been reused, so a handle kept past destroy() is recognised as dead instead of silently
+  // pointing at whatever took the slot next.
+  struct Entity {
+    uint32_t index      = 0;
+    uint32_t generation = 0;
+
+    bool operator==(const Entity &) const = default;
+  };
+
+  using ComponentMask = uint32_t;
+
+  // Every component type a World can hold. An archetype stores a subset of them, one tightly packed
+  // column per type, so a system only streams through the components it asks for.
+  using ComponentTypes = std::tuple<Transform2dComponent,
+                                    RigidBody2dComponent,
+                                    ColourComponent,
+                                    ModelComponent,
+                                    FieldSampleComponent>;
+
+  template <typename T, typename Tuple>
+  struct ComponentIndex;
+
+  template <typename T, typename... Ts>
+  struct ComponentIndex<T, std::tuple<T, Ts...>> : std::integral_constant<size_t, 0> {};
+
+  template <typename T, typename U, typename... Ts>
+  struct ComponentIndex<T, std::tuple<U, Ts...>>
+      : std::integral_constant<size_t, 1 + ComponentIndex<T, std::tuple<Ts...>>::value> {};
+
+  template <typename... Cs>
+  constexpr ComponentMask componentMask() {
+    return (ComponentMask{0} | ... |
+            (ComponentMask{1} << ComponentIndex<Cs, ComponentTypes>::value));
+  }
+
+  static_assert(std::tuple_size_v<ComponentTypes> <= sizeof(ComponentMask) * 8,
+                "Too many component types for ComponentMask");
+
+  // All entities with exactly the same set of components. Rows line up across the columns, row i
+  // of every column belongs to entities()[i].
+  class Archetype {
+  public:
+    explicit Archetype(ComponentMask mask) : m_mask{mask} {}
+
+    ComponentMask mask() const { return m_mask; }
+    size_t size() const { return m_entities.size(); }
+    const std::vector<Entity> &entities() const { return m_entities; }
+    // bumped whenever rows are added or removed, so cached row orders can tell they are stale
+    uint64_t version() const { return m_version; }
+
+    template <typename T>
+    bool has() const {
+      return (m_mask & componentMask<T>()) != 0;
+    }
+
+    template <typename T>
+    std::span<T> column() {
+      ASSERT_LOG(has<T>(), "Archetype has no column for the requested component");
+      return std::get<std::vector<T>>(m_columns);
+    }
+
+    // components must be exactly the archetype's set, in any order
+    template <typename... Cs>
+    size_t push(Entity entity, Cs &&...components) {
+      ASSERT_LOG(componentMask<std::decay_t<Cs>...>() == m_mask,
+                 "Components do not match the archetype");
+      (std::get<std::vector<std::decay_t<Cs>>>(m_columns).push_back(std::forward<Cs>(components)),
+       ...);
+      m_entities.push_back(entity);
+      m_version++;
+      return m_entities.size() - 1;
+    }
+
+    // Moves the last row into row and shrinks by one. Returns the entity that now lives at row,
+    // which is the removed one itself if it was last.
+    Entity swapRemove(size_t row) {
+      std::apply(
+          [&](auto &...columns) {
+            // columns outside the mask are empty and skipped
+            ((columns.empty() ? void() : (columns[row] = std::move(columns.back()),
+                                          columns.pop_back())),
+             ...);
+          },
+          m_columns);
+      const Entity removed = m_entities[row];
+      m_entities[row]      = m_entities.back();
+      m_entities.pop_back();
+      m_version++;
+      return row < m_entities.size() ? m_entities[row] : removed;
+    }
+
+  private:
+    template <typename Tuple>
+    struct Columns;
+    template <typename... Ts>
+    struct Columns<std::tuple<Ts...>> {
+      using type = std::tuple<std::vector<Ts>...>;
+    };
+
+    ComponentMask m_mask;
+    uint64_t m_version = 0;
+    std::vector<Entity> m_entities;
+    // columns of components outside the mask stay empty
+    typename Columns<ComponentTypes>::type m_columns;
+  };
+
+  // The matching columns of one archetype in a view.
+  template <typename... Cs>
+  class ViewChunk {
+  public:
+    explicit ViewChunk(Archetype &archetype) : m_archetype{&archetype} {}
+
+    size_t size() const { return m_archetype->size(); }
+    ComponentMask mask() const { return m_archetype->mask(); }
+    const std::vector<Entity> &entities() const { return m_archetype->entities(); }
+
+    template <typename T>
+    std::span<T> get() const {
+      static_assert((std::is_same_v<T, Cs> || ...), "Component is not part of the view");
+      return m_archetype->column<T>();
+    }
+
+  private:
+    Archetype *m_archetype;
+  };
+
+  // Every archetype holding at least the components Cs, iterated one chunk per archetype. The
+  // order is stable as long as no entities are created or destroyed, so arrays filled from one
+  // pass over a view line up with the next while version() stays the same.
+  template <typename... Cs>
+  class View {
+  public:
+    class Iterator {
+    public:
+      Iterator(Archetype *const *archetype) : m_archetype{archetype} {}
+      ViewChunk<Cs...> operator*() const { return ViewChunk<Cs...>{**m_archetype}; }
+      Iterator &operator++() {
+        m_archetype++;
+        return *this;
+      }
+      bool operator!=(const Iterator &other) const { return m_archetype != other.m_archetype; }
+
+    private:
+      Archetype *const *m_archetype;
+    };
+
+    explicit View(std::vector<Archetype *> archetypes) : m_archetypes{std::move(archetypes)} {}
+
+    Iterator begin() const { return Iterator{m_archetypes.data()}; }
+    Iterator end() const { return Iterator{m_archetypes.data() + m_archetypes.size()}; }
+
+    size_t size() const {
+      size_t count = 0;
+      for (auto *archetype : m_archetypes) {
+        count += archetype->size();
+      }
+      return count;
+    }
+
+    uint64_t version() const {
+      uint64_t version = 0;
+      for (auto *archetype : m_archetypes) {
+        version += archetype->version();
+      }
+      return version;
+    }
+
+    // fn(Cs &...) for every entity, chunk by chunk
+    template <typename Fn>
+    void each(Fn &&fn) const {
+      for (auto *archetype : m_archetypes) {
+        auto columns = std::make_tuple(archetype->column<Cs>()...);
+        for (size_t row = 0; row < archetype->size(); row++) {
+          fn(std::get<std::span<Cs>>(columns)[row]...);
+        }
+      }
+    }
+
+  private:
+    std::vector<Archetype *> m_archetypes;
+  };
+
+  // Archetype based entity storage. Entities are created with their full set of components and
+  // land in the archetype for that set, systems then walk typed views over the columns they need
+  // instead of whole objects.
+  //
+  // Handles are resolved through a sparse array of slots, each holding the generation and the
+  // entity's archetype and row, while the archetype rows are the dense side and point back at
+  // their entity. Creating, destroying and looking up an entity are all O(1), destroyed slots are
+  // recycled so memory stays bounded by the peak entity count. Views must not be iterated while
+  // entities are created or destroyed.
+  class World {
+  public:
+    World()                         = default;
+    World(const World &)            = delete;
+    World &operator=(const World &) = delete;
+
+    template <typename... Cs>
+    Entity create(Cs &&...components) {
+      constexpr ComponentMask mask = componentMask<std::decay_t<Cs>...>();
+      static_assert(std::popcount(mask) == sizeof...(Cs), "Each component type may appear once");
+
+      uint32_t index;
+      if (m_freeSlots.empty()) {
+        index = static_cast<uint32_t>(m_slots.size());
+        m_slots.emplace_back();
+      } else {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+      }
+
+      Slot &slot          = m_slots[index];
+      const Entity entity = {index, slot.generation};
+      slot.archetype      = archetypeFor(mask);
+      slot.row            = static_cast<uint32_t>(
+          m_archetypes[slot.archetype].push(entity, std::forward<Cs>(components)...));
+      m_aliveCount++;
+      return entity;
+    }
+
+    void destroy(Entity entity) {
+      ASSERT_LOG(alive(entity), "Entity {} is not alive", entity.index);
+      Slot &slot   = m_slots[entity.index];
+      Entity moved = m_archetypes[slot.archetype].swapRemove(slot.row);
+
+      m_slots[moved.index].row = slot.row;
+
+      slot.generation++;
+      slot.archetype = DEAD;
+      m_freeSlots.push_back(entity.index);
+      m_aliveCount--;
+    }
+
+    bool alive(Entity entity) const {
+      return entity.index < m_slots.size() && m_slots[entity.index].archetype != DEAD &&
+             m_slots[entity.index].generation == entity.generation;
+    }
+
+    template <typename T>
+    bool has(Entity entity) const {
+      return m_archetypes[slotOf(entity).archetype].has<T>();
+    }
+
+    template <typename T>
+    T &get(Entity entity) {
+      const Slot &slot = slotOf(entity);
+      return m_archetypes[slot.archetype].column<T>()[slot.row];
+    }
+
+    // live entities
+    size_t size() const { return m_aliveCount; }
+
+    size_t archetypeCount() const { return m_archetypes.size(); }
+    ComponentMask archetypeMask(size_t archetype) const { return m_archetypes[archetype].mask(); }
+
+    template <typename... Cs>
+    View<Cs...> view() {
+      constexpr ComponentMask mask = componentMask<Cs...>();
+      std::vector<Archetype *> matches;
+      for (auto &archetype : m_archetypes) {
+        if ((archetype.mask() & mask) == mask) {
+          matches.push_back(&archetype);
+        }
+      }
+      return View<Cs...>{std::move(matches)};
+    }
+
+  private:
+    static constexpr uint32_t DEAD = UINT32_MAX;
+
+    struct Slot {
+      uint32_t generation = 0;
+      uint32_t archetype  = DEAD;
+      uint32_t row        = 0;
+    };
+
+    const Slot &slotOf(Entity entity) const {
+      ASSERT_LOG(alive(entity), "Entity {} is not alive", entity.index);
+      return m_slots[entity.index];
+    }
+
+    // there are only ever a handful of archetypes, so a linear search is enough
+    uint32_t archetypeFor(ComponentMask mask) {
+      for (size_t i = 0; i < m_archetypes.size(); i++) {
+        if (m_archetypes[i].mask() == mask) {
+          return static_cast<uint32_t>(i);
+        }
+      }
+      m_archetypes.emplace_back(mask);
+      return static_cast<uint32_t>(m_archetypes.size() - 1);
+    }
+
+    std::vector<Archetype> m_archetypes;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    size_t m_aliveCount = 0;
+  };
+} // namespace kopi
@@ -0,0 +1,18 @@
+#version 450
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec3 colour;
+// per instance, read straight from the body storage buffer
+layout(location = 2) in vec2 bodyPosition;
+layout(location = 3) in vec4 bodyColour;
+
+layout(location = 0) out vec3 fragColour;
+
+layout(push_constant) uniform Push {
+  mat2 transform;
+} push;
+
+void main() {
+  gl_Position = vec4(push.transform * position + bodyPosition, 0.0, 1.0);
+  fragColour  = bodyColour.rgb;
+}
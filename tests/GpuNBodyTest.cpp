@@ -0,0 +1,205 @@
+// A few GpuNBodySystem steps on a headless device against the CPU direct-sum path. Both run
+// unsoftened semi-implicit Euler in float, so they only differ by summation order and
+// inversesqrt rounding. Runs wherever a Vulkan driver does, lavapipe included, and reports
+// itself skipped when there is none, unless KOPI_REQUIRE_VULKAN is set as it is on CI.
+//
+// Usage: gpu_nbody_test [pipeline cache path]
+#include "EngineDevice.h"
+#include "GpuNBodySystem.h"
+#include "GravityPhysicsSystem.h"
+#include "Log.h"
+#include "PipelineLibrary.h"
+#include "StagingRing.h"
+#include "World.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace kopi;
+
+static constexpr int SKIPPED              = 77; // SKIP_RETURN_CODE in tests/CMakeLists.txt
+static constexpr float STRENGTH           = 0.81f;
+static constexpr float STEP_DELTA         = 1.0f / 60;
+static constexpr int STEPS                = 8;
+static constexpr int GRID                 = 17; // 289 bodies, the last workgroup is partial
+static constexpr float MAX_POSITION_ERROR = 1e-5f;
+static constexpr float MAX_VELOCITY_ERROR = 1e-5f;
+
+// a jittered grid over [-1, 1], so no pair comes close enough to blow up without softening
+static void createBodies(World &world) {
+  std::mt19937 random{42};
+  std::uniform_real_distribution<float> jitter{-0.02f, 0.02f};
+  std::uniform_real_distribution<float> speed{-0.1f, 0.1f};
+  std::uniform_real_distribution<float> mass{0.5f, 2.0f};
+  const float spacing = 2.0f / (GRID - 1);
+  for (int i = 0; i < GRID; i++) {
+    for (int j = 0; j < GRID; j++) {
+      Transform2dComponent transform{};
+      transform.translation = {-1.0f + i * spacing + jitter(random),
+                               -1.0f + j * spacing + jitter(random)};
+      RigidBody2dComponent rigidBody{};
+      rigidBody.velocity = {speed(random), speed(random)};
+      rigidBody.mass     = mass(random) / (GRID * GRID);
+      world.create(transform, rigidBody, ColourComponent{glm::vec3{1.0f}});
+    }
+  }
+}
+
+static void bufferBarrier(VkCommandBuffer commandBuffer,
+                          VkBuffer buffer,
+                          VkPipelineStageFlags srcStage,
+                          VkAccessFlags srcAccess,
+                          VkPipelineStageFlags dstStage,
+                          VkAccessFlags dstAccess) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask       = srcAccess;
+  barrier.dstAccessMask       = dstAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer              = buffer;
+  barrier.size                = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// Runs STEPS dispatches and reads the bodies back. Returns false if the pipeline never compiled.
+static bool runGpu(EngineDevice &device, World &world, std::vector<GpuNBodySystem::Body> &out) {
+  StagingRing staging{device};
+  PipelineLibrary pipelines{device};
+  GpuNBodySystem system{device, staging, pipelines, VK_NULL_HANDLE, world, STRENGTH};
+  system.softening = 0.0f;
+  staging.wait();
+  pipelines.waitIdle();
+  if (!system.ready()) {
+    return false;
+  }
+
+  const VkDeviceSize size = sizeof(GpuNBodySystem::Body) * system.bodyCount();
+  VkBuffer readback       = VK_NULL_HANDLE;
+  MemoryAllocation readbackMemory{};
+  device.createBuffer(size,
+                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      readback,
+                      readbackMemory);
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool        = device.getCommandPool();
+  allocInfo.commandBufferCount = 1;
+  VkCommandBuffer commandBuffer;
+  vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  for (int step = 0; step < STEPS; step++) {
+    system.dispatch(commandBuffer, STEP_DELTA);
+  }
+  bufferBarrier(commandBuffer,
+                system.bodyBuffer(),
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_READ_BIT);
+  VkBufferCopy region{};
+  region.size = size;
+  vkCmdCopyBuffer(commandBuffer, system.bodyBuffer(), readback, 1, &region);
+  bufferBarrier(commandBuffer,
+                readback,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_HOST_BIT,
+                VK_ACCESS_HOST_READ_BIT);
+  vkEndCommandBuffer(commandBuffer);
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  vkCreateFence(device.device(), &fenceInfo, nullptr, &fence);
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &commandBuffer;
+  vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, fence);
+  vkWaitForFences(device.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+
+  const auto *bodies = static_cast<const GpuNBodySystem::Body *>(readbackMemory.mapped);
+  out.assign(bodies, bodies + system.bodyCount());
+
+  vkDestroyFence(device.device(), fence, nullptr);
+  vkFreeCommandBuffers(device.device(), device.getCommandPool(), 1, &commandBuffer);
+  device.destroyBuffer(readback, readbackMemory);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  PEREZLOG::Log::init();
+  const std::string cachePath = argc > 1 ? argv[1] : "gpu_nbody_test_pipeline_cache.bin";
+
+  std::unique_ptr<EngineDevice> device;
+  try {
+    device = std::make_unique<EngineDevice>(cachePath);
+  } catch (const std::exception &error) {
+    std::printf("no usable Vulkan device: %s\n", error.what());
+    return std::getenv("KOPI_REQUIRE_VULKAN") != nullptr ? 1 : SKIPPED;
+  }
+  std::printf("device: %s\n", device->properties.deviceName);
+
+  World world;
+  createBodies(world);
+
+  // the CPU path walks the same archetype, so bodies come out in the same order
+  BodyStore expected;
+  expected.loadFrom(world);
+  GravityPhysicsSystem gravity{STRENGTH};
+  gravity.solver     = GravitySolver::DirectSum;
+  gravity.integrator = Integrator::SemiImplicitEuler;
+  for (int step = 0; step < STEPS; step++) {
+    gravity.update(expected, STEP_DELTA, 1);
+  }
+
+  std::vector<GpuNBodySystem::Body> actual;
+  if (!runGpu(*device, world, actual)) {
+    std::printf("FAILED: nbody.comp did not compile\n");
+    return 1;
+  }
+  if (actual.size() != expected.size()) {
+    std::printf("FAILED: %zu bodies came back, expected %zu\n", actual.size(), expected.size());
+    return 1;
+  }
+
+  float positionError = 0.0f;
+  float velocityError = 0.0f;
+  for (size_t i = 0; i < expected.size(); i++) {
+    positionError = std::max(positionError,
+                             glm::length(actual[i].position -
+                                         glm::vec2{expected.posX[i], expected.posY[i]}));
+    velocityError = std::max(velocityError,
+                             glm::length(actual[i].velocity -
+                                         glm::vec2{expected.velX[i], expected.velY[i]}));
+  }
+  const bool passed =
+      positionError <= MAX_POSITION_ERROR && velocityError <= MAX_VELOCITY_ERROR;
+  std::printf("%zu bodies, %d steps: max position error %.3g (limit %.0g), max velocity error "
+              "%.3g (limit %.0g) %s\n",
+              expected.size(),
+              STEPS,
+              positionError,
+              MAX_POSITION_ERROR,
+              velocityError,
+              MAX_VELOCITY_ERROR,
+              passed ? "ok" : "FAILED");
+
+  vkDeviceWaitIdle(device->device());
+  return passed ? 0 : 1;
+}
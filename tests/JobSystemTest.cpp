@@ -0,0 +1,104 @@
+// A job that throws must still finish: its exception comes back out of wait and parallelFor on
+// the waiting thread, after every helper has drained, and dependents finish without running.
+#include "JobSystem.h"
+
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace kopi;
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+  if (!condition) {
+    std::printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+// true when calling fn throws std::runtime_error
+template <typename Fn>
+static bool throws(Fn &&fn) {
+  try {
+    fn();
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+static void failedJobFinishes(JobSystem &jobs) {
+  std::atomic<bool> dependentRan{false};
+  JobHandle failing   = jobs.schedule([] { throw std::runtime_error("job"); });
+  JobHandle dependent = jobs.schedule([&] { dependentRan = true; }, {failing});
+  JobHandle sibling   = jobs.schedule([] {});
+
+  check(throws([&] { jobs.wait(dependent); }), "dependent of a failed job rethrows");
+  check(failing->finished() && failing->failed(), "failed job finishes");
+  check(!dependentRan, "dependent of a failed job does not run");
+  check(!throws([&] { jobs.wait(sibling); }), "unrelated job is unaffected");
+
+  // scheduled after the failure already happened
+  JobHandle late = jobs.schedule([&] { dependentRan = true; }, {failing});
+  check(throws([&] { jobs.wait(late); }) && !dependentRan, "late dependent inherits failure");
+}
+
+static void waitDrainsEveryJob(JobSystem &jobs) {
+  std::atomic<int> ran{0};
+  std::vector<JobHandle> batch;
+  batch.push_back(jobs.schedule([] { throw std::runtime_error("first"); }));
+  for (int i = 0; i < 32; i++) {
+    batch.push_back(jobs.schedule([&] { ran++; }));
+  }
+  check(throws([&] { jobs.wait(batch); }), "wait on a batch rethrows");
+  check(ran == 32, "wait on a batch drains the rest");
+}
+
+static void parallelForRethrowsAfterDraining(JobSystem &jobs) {
+  for (int round = 0; round < 200; round++) {
+    std::atomic<int> running{0};
+    const bool threw = throws([&] {
+      jobs.parallelFor(256, 1, [&](size_t begin, size_t) {
+        running++;
+        if (begin == 17) {
+          running--;
+          throw std::runtime_error("range");
+        }
+        std::this_thread::yield();
+        running--;
+      });
+    });
+    check(threw, "parallelFor rethrows");
+    // anything still inside fn here is a helper touching the unwound frame
+    check(running.load() == 0, "parallelFor returns only after its helpers");
+  }
+}
+
+// recordSecondary's shape: a parallelFor that throws inside a job another thread waits on
+static void nestedFailure(JobSystem &jobs) {
+  JobHandle outer = jobs.schedule([&] {
+    jobs.parallelFor(64, 1, [](size_t begin, size_t) {
+      if (begin == 40) {
+        throw std::runtime_error("nested");
+      }
+    });
+  });
+  JobHandle after = jobs.schedule([] {}, {outer});
+  check(throws([&] { jobs.wait(after); }), "nested failure reaches the waiter");
+  check(!throws([&] { jobs.parallelFor(64, 1, [](size_t, size_t) {}); }), "system still usable");
+}
+
+int main() {
+  for (unsigned int threads : {1u, 2u, 4u}) {
+    JobSystem jobs{threads};
+    failedJobFinishes(jobs);
+    waitDrainsEveryJob(jobs);
+    parallelForRethrowsAfterDraining(jobs);
+    nestedFailure(jobs);
+  }
+  std::printf("%s\n", failures == 0 ? "all passed" : "failed");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// The force pass splits bodies into fixed blocks that do not depend on the thread count, so a
+// simulation must come out bit-identical whether it runs on the calling thread or on a JobSystem
+// of any size. Every solver, and the block timestep path, steps the same scene a few frames on
+// each and the arrays are compared byte for byte.
+#include "GravityPhysicsSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace kopi;
+
+static constexpr float STRENGTH    = 0.81f;
+static constexpr float FRAME_DELTA = 1.0f / 60;
+static constexpr int FRAMES        = 4;
+static constexpr size_t BODY_COUNT = 3000; // twelve force blocks, more than most pools have threads
+
+static BodyStore clusteredScene() {
+  std::mt19937 random{7};
+  std::uniform_real_distribution<float> centre{-0.6f, 0.6f};
+  std::normal_distribution<float> spread{0.0f, 0.08f};
+  std::uniform_real_distribution<float> mass{0.5f, 2.0f};
+  BodyStore bodies;
+  bodies.resize(BODY_COUNT);
+  const float centres[3][2] = {{centre(random), centre(random)},
+                               {centre(random), centre(random)},
+                               {centre(random), centre(random)}};
+  for (size_t i = 0; i < BODY_COUNT; i++) {
+    bodies.posX[i] = centres[i % 3][0] + spread(random);
+    bodies.posY[i] = centres[i % 3][1] + spread(random);
+    bodies.velX[i] = 0.1f * spread(random);
+    bodies.velY[i] = 0.1f * spread(random);
+    bodies.mass[i] = mass(random) / BODY_COUNT;
+  }
+  return bodies;
+}
+
+struct Config {
+  const char *name;
+  GravitySolver solver;
+  bool adaptive;
+};
+
+static constexpr Config CONFIGS[] = {
+    {"direct sum",           GravitySolver::DirectSum,    false},
+    {"barnes-hut",           GravitySolver::BarnesHut,    false},
+    {"particle mesh",        GravitySolver::ParticleMesh, false},
+    {"direct sum, adaptive", GravitySolver::DirectSum,    true },
+};
+
+static BodyStore simulate(const Config &config, JobSystem *jobSystem) {
+  GravityPhysicsSystem gravity{STRENGTH};
+  gravity.solver            = config.solver;
+  gravity.integrator        = Integrator::Leapfrog;
+  gravity.adaptiveTimesteps = config.adaptive;
+  gravity.meshResolution    = 128;
+  gravity.jobSystem         = jobSystem;
+
+  BodyStore bodies = clusteredScene();
+  for (int frame = 0; frame < FRAMES; frame++) {
+    gravity.update(bodies, FRAME_DELTA, 2);
+  }
+  return bodies;
+}
+
+static bool identical(const AlignedFloats &a, const AlignedFloats &b) {
+  return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+int main() {
+  const unsigned int many = std::max(4u, std::thread::hardware_concurrency());
+  std::vector<std::unique_ptr<JobSystem>> pools;
+  for (unsigned int threads : {1u, 2u, many}) {
+    pools.push_back(std::make_unique<JobSystem>(threads));
+  }
+
+  int failures = 0;
+  for (const Config &config : CONFIGS) {
+    const BodyStore reference = simulate(config, nullptr);
+    for (auto &pool : pools) {
+      const BodyStore result = simulate(config, pool.get());
+      bool same              = identical(result.accX, reference.accX);
+      same                   = same && identical(result.accY, reference.accY);
+      same                   = same && identical(result.posX, reference.posX);
+      same                   = same && identical(result.posY, reference.posY);
+      same                   = same && identical(result.velX, reference.velX);
+      same                   = same && identical(result.velY, reference.velY);
+      std::printf("%-22s %2u threads: %s\n",
+                  config.name,
+                  pool->threadCount(),
+                  same ? "bit-identical" : "DIFFERS");
+      failures += same ? 0 : 1;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
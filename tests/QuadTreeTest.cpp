@@ -0,0 +1,121 @@
+// Barnes-Hut forces against the direct sum on random scenes, at the theta GravityPhysicsSystem
+// uses by default. The quadrupole tree is documented at about 0.2% RMS error with theta = 0.5,
+// the bounds leave room for float rounding and for the few bodies where the field nearly cancels.
+#include "BodyStore.h"
+#include "NBodyKernel.h"
+#include "QuadTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace kopi;
+
+static constexpr float THETA             = 0.5f;
+static constexpr float STRENGTH          = 0.81f;
+static constexpr double MAX_RMS_ERROR    = 0.01;  // relative to each body's direct-sum force
+static constexpr double MAX_MEDIAN_ERROR = 0.002;
+static constexpr double MAX_WORST_ERROR  = 0.01;  // worst body, relative to the RMS force
+
+static BodyStore uniformScene(size_t count, uint32_t seed) {
+  std::mt19937 random{seed};
+  std::uniform_real_distribution<float> position{-1.0f, 1.0f};
+  std::uniform_real_distribution<float> mass{0.5f, 2.0f};
+  BodyStore bodies;
+  bodies.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    bodies.posX[i] = position(random);
+    bodies.posY[i] = position(random);
+    bodies.mass[i] = mass(random) / count;
+  }
+  return bodies;
+}
+
+// a few dense gaussian clusters, where most cells are opened close to their centre of mass
+static BodyStore clusteredScene(size_t count, uint32_t seed) {
+  std::mt19937 random{seed};
+  std::uniform_real_distribution<float> centre{-0.8f, 0.8f};
+  std::uniform_real_distribution<float> mass{0.5f, 2.0f};
+  std::normal_distribution<float> spread{0.0f, 0.05f};
+  const size_t clusters = 6;
+  float centreX[clusters];
+  float centreY[clusters];
+  for (size_t c = 0; c < clusters; c++) {
+    centreX[c] = centre(random);
+    centreY[c] = centre(random);
+  }
+  BodyStore bodies;
+  bodies.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    bodies.posX[i] = centreX[i % clusters] + spread(random);
+    bodies.posY[i] = centreY[i % clusters] + spread(random);
+    bodies.mass[i] = mass(random) / count;
+  }
+  return bodies;
+}
+
+static bool checkScene(const char *name, BodyStore &bodies) {
+  const size_t count = bodies.size();
+  std::fill(bodies.accX.begin(), bodies.accX.end(), 0.0f);
+  std::fill(bodies.accY.begin(), bodies.accY.end(), 0.0f);
+  directSumAccelerations(bodies.posX.data(),
+                         bodies.posY.data(),
+                         bodies.paddedSize(),
+                         bodies.posX.data(),
+                         bodies.posY.data(),
+                         bodies.mass.data(),
+                         bodies.paddedSize(),
+                         STRENGTH,
+                         bodies.accX.data(),
+                         bodies.accY.data());
+
+  QuadTree tree;
+  tree.build(bodies.posX.data(), bodies.posY.data(), bodies.mass.data(), count);
+
+  std::vector<double> errors(count);
+  double forceSquaredSum = 0.0;
+  double errorSquaredSum = 0.0;
+  double worstError      = 0.0;
+  for (size_t i = 0; i < count; i++) {
+    glm::vec2 approximate = tree.computeAcceleration(
+        {bodies.posX[i], bodies.posY[i]}, static_cast<uint32_t>(i), THETA, STRENGTH);
+    double exactX   = bodies.accX[i];
+    double exactY   = bodies.accY[i];
+    double exact    = std::sqrt(exactX * exactX + exactY * exactY);
+    double error    = std::hypot(approximate.x - exactX, approximate.y - exactY);
+    errors[i]       = error / exact;
+    forceSquaredSum += exact * exact;
+    errorSquaredSum += errors[i] * errors[i];
+    worstError      = std::max(worstError, error);
+  }
+  std::nth_element(errors.begin(), errors.begin() + count / 2, errors.end());
+  const double rmsError    = std::sqrt(errorSquaredSum / count);
+  const double median      = errors[count / 2];
+  const double scaledWorst = worstError / std::sqrt(forceSquaredSum / count);
+
+  const bool passed =
+      rmsError <= MAX_RMS_ERROR && median <= MAX_MEDIAN_ERROR && scaledWorst <= MAX_WORST_ERROR;
+  std::printf("%-10s %5zu bodies, %5zu nodes: rms %.4f%%, median %.4f%%, worst %.4f%% of rms "
+              "force %s\n",
+              name,
+              count,
+              tree.nodeCount(),
+              100.0 * rmsError,
+              100.0 * median,
+              100.0 * scaledWorst,
+              passed ? "ok" : "FAILED");
+  return passed;
+}
+
+int main() {
+  bool passed = true;
+  for (uint32_t seed = 1; seed <= 3; seed++) {
+    BodyStore uniform = uniformScene(1000 * seed + 500, seed);
+    passed &= checkScene("uniform", uniform);
+    BodyStore clustered = clusteredScene(1000 * seed + 500, seed);
+    passed &= checkScene("clustered", clustered);
+  }
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// The scheduler orders systems only where they share an archetype. Two systems writing the same
+// component on disjoint archetypes must get no dependency and actually run at the same time on a
+// JobSystem, while systems that conflict never overlap. The frame graph Application::run builds
+// is checked for the same shape.
+#include "SystemScheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace kopi;
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+  if (!condition) {
+    std::printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static constexpr ComponentMask TRANSFORM = componentMask<Transform2dComponent>();
+static constexpr ComponentMask BODY_QUERY =
+    componentMask<Transform2dComponent, RigidBody2dComponent>();
+static constexpr ComponentMask SAMPLE_QUERY =
+    componentMask<Transform2dComponent, ColourComponent, FieldSampleComponent>();
+
+// the two archetypes Application::run creates, bodies and vector field arrows
+static void createScene(World &world) {
+  for (int i = 0; i < 2; i++) {
+    world.create(
+        Transform2dComponent{}, RigidBody2dComponent{}, ColourComponent{}, ModelComponent{});
+  }
+  for (int i = 0; i < 16; i++) {
+    world.create(
+        Transform2dComponent{}, ColourComponent{}, ModelComponent{}, FieldSampleComponent{});
+  }
+}
+
+// Spins until every system in the group has started, true if they all did within the timeout.
+// A system that runs strictly after another can never see it start alongside.
+static bool meet(std::atomic<int> &started, int group) {
+  started++;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (started.load() < group) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+static void disjointSystemsOverlap(World &world, JobSystem &jobs) {
+  std::atomic<int> started{0};
+  std::atomic<int> met{0};
+  SystemScheduler scheduler;
+  scheduler.add("bodies", {{BODY_QUERY, TRANSFORM, TRANSFORM}}, [&](World &) {
+    met += meet(started, 2) ? 1 : 0;
+  });
+  scheduler.add("samples", {{SAMPLE_QUERY, TRANSFORM, TRANSFORM}}, [&](World &) {
+    met += meet(started, 2) ? 1 : 0;
+  });
+  scheduler.run(world, &jobs);
+  check(scheduler.dependencies(1).empty(), "disjoint systems get no dependency");
+  check(met == 2, "disjoint systems run at the same time");
+}
+
+static void conflictingSystemsDoNotOverlap(World &world, JobSystem &jobs) {
+  std::atomic<int> running{0};
+  std::atomic<bool> overlapped{false};
+  auto exclusive = [&](World &) {
+    if (running.fetch_add(1) != 0) {
+      overlapped = true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    running--;
+  };
+  SystemScheduler scheduler;
+  scheduler.add("bodies", {{BODY_QUERY, TRANSFORM, TRANSFORM}}, exclusive);
+  scheduler.add("everything", {{TRANSFORM, TRANSFORM, TRANSFORM}}, exclusive);
+  scheduler.add("samples", {{SAMPLE_QUERY, TRANSFORM, TRANSFORM}}, exclusive);
+  scheduler.run(world, &jobs);
+  check(scheduler.dependencies(1) == std::vector<size_t>{0}, "shared archetype orders systems");
+  check(scheduler.dependencies(2) == std::vector<size_t>{1}, "conflict found on the other one");
+  check(!overlapped, "conflicting systems never overlap");
+}
+
+// the declarations Application::run registers, in the same order
+static void frameGraphShape(World &world) {
+  constexpr ComponentMask drawQuery =
+      componentMask<Transform2dComponent, ColourComponent, ModelComponent>();
+  constexpr ComponentMask fieldWrites = componentMask<Transform2dComponent, ColourComponent>();
+  SystemScheduler scheduler;
+  scheduler.add("interpolate", {{BODY_QUERY, 0, TRANSFORM}}, [](World &) {});
+  scheduler.add("vector field",
+                {{BODY_QUERY, BODY_QUERY, 0}, {SAMPLE_QUERY, SAMPLE_QUERY, fieldWrites}},
+                [](World &) {});
+  scheduler.add("sample transforms", {{SAMPLE_QUERY, TRANSFORM, TRANSFORM}}, [](World &) {});
+  scheduler.add("body transforms", {{BODY_QUERY, TRANSFORM, TRANSFORM}}, [](World &) {});
+  scheduler.add("render", {{drawQuery, drawQuery, 0}}, [](World &) {});
+  scheduler.run(world, nullptr);
+
+  check(scheduler.dependencies(1) == std::vector<size_t>{0}, "field waits for interpolate");
+  check(scheduler.dependencies(2) == std::vector<size_t>{1}, "sample transforms wait for field");
+  check(scheduler.dependencies(3) == std::vector<size_t>({0, 1}),
+        "body transforms wait only for the body side");
+  check(scheduler.dependencies(4) == std::vector<size_t>({0, 1, 2, 3}), "render waits for all");
+}
+
+int main() {
+  World world;
+  createScene(world);
+
+  JobSystem jobs{2};
+  disjointSystemsOverlap(world, jobs);
+  conflictingSystemsDoNotOverlap(world, jobs);
+  frameGraphShape(world);
+  std::printf("%s\n", failures == 0 ? "all passed" : "failed");
+  return failures == 0 ? 0 : 1;
+}
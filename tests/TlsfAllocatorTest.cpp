@@ -0,0 +1,140 @@
+// TlsfAllocator bookkeeping, which MemoryAllocator::stats reports per block: ranges come out
+// aligned and never overlap, used bytes and free ranges add up after every call, neighbours merge
+// on free so fragmentation returns to zero, and a request that cannot fit fails cleanly.
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace kopi;
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+  if (!condition) {
+    std::printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static constexpr uint64_t POOL_SIZE = 1ull << 20;
+
+struct Live {
+  uint32_t handle;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// the stats MemoryAllocator builds for a single block
+static MemoryStats statsOf(const TlsfAllocator &tlsf) {
+  MemoryStats stats{};
+  stats.blockCount       = 1;
+  stats.allocationCount  = tlsf.allocationCount();
+  stats.bytesReserved    = tlsf.size();
+  stats.bytesUsed        = tlsf.usedBytes();
+  stats.freeRangeCount   = tlsf.freeRangeCount();
+  stats.largestFreeRange = tlsf.largestFreeRange();
+  return stats;
+}
+
+static void mergesOnFree() {
+  TlsfAllocator tlsf{POOL_SIZE};
+  check(tlsf.freeRangeCount() == 1 && tlsf.largestFreeRange() == POOL_SIZE, "starts as one range");
+
+  uint64_t offsets[3];
+  uint32_t handles[3];
+  for (int i = 0; i < 3; i++) {
+    handles[i] = tlsf.allocate(1000, 1, offsets[i]);
+  }
+  const uint64_t rounded = 1024; // 1000 up to GRANULARITY
+  check(tlsf.usedBytes() == 3 * rounded, "sizes round up to the granularity");
+  check(tlsf.allocationCount() == 3, "three allocations");
+
+  tlsf.free(handles[1]);
+  const MemoryStats holed = statsOf(tlsf);
+  check(holed.freeRangeCount == 2, "a hole in the middle is its own range");
+  check(holed.largestFreeRange == POOL_SIZE - 3 * rounded, "the tail is the largest range");
+  check(holed.fragmentation() > 0.0f, "a hole fragments the free space");
+
+  tlsf.free(handles[0]);
+  tlsf.free(handles[2]);
+  const MemoryStats empty = statsOf(tlsf);
+  check(empty.freeRangeCount == 1 && empty.largestFreeRange == POOL_SIZE, "frees merge back");
+  check(empty.bytesUsed == 0 && empty.allocationCount == 0, "nothing left in use");
+  check(empty.fragmentation() == 0.0f, "one free range is not fragmented");
+}
+
+static void alignsAndFails() {
+  TlsfAllocator tlsf{POOL_SIZE};
+  uint64_t offset = 0;
+  tlsf.allocate(256, 1, offset);
+  const uint32_t aligned = tlsf.allocate(256, 4096, offset);
+  check(aligned != TlsfAllocator::NONE && offset % 4096 == 0, "alignment is honoured");
+  check(tlsf.freeRangeCount() == 2, "alignment padding stays free");
+  check(tlsf.allocate(POOL_SIZE, 1, offset) == TlsfAllocator::NONE, "oversized request fails");
+  check(tlsf.allocationCount() == 2, "a failed request allocates nothing");
+}
+
+static void randomChurn() {
+  TlsfAllocator tlsf{POOL_SIZE};
+  std::mt19937 random{3};
+  std::uniform_int_distribution<uint64_t> size{1, 20000};
+  std::uniform_int_distribution<int> alignmentShift{0, 12};
+  std::vector<Live> live;
+  bool consistent = true;
+  for (int step = 0; step < 20000; step++) {
+    if (live.empty() || random() % 3 != 0) {
+      Live allocation{};
+      allocation.size          = size(random);
+      const uint64_t alignment = 1ull << alignmentShift(random);
+      allocation.handle        = tlsf.allocate(allocation.size, alignment, allocation.offset);
+      if (allocation.handle == TlsfAllocator::NONE) {
+        continue;
+      }
+      consistent = consistent && allocation.offset % alignment == 0 &&
+                   allocation.offset + allocation.size <= POOL_SIZE;
+      live.push_back(allocation);
+    } else {
+      const size_t victim = random() % live.size();
+      tlsf.free(live[victim].handle);
+      live[victim] = live.back();
+      live.pop_back();
+    }
+    consistent = consistent && tlsf.allocationCount() == live.size();
+  }
+  check(consistent, "allocations stay aligned, in range and counted");
+
+  std::sort(live.begin(), live.end(), [](const Live &a, const Live &b) {
+    return a.offset < b.offset;
+  });
+  bool disjoint = true;
+  for (size_t i = 1; i < live.size(); i++) {
+    disjoint = disjoint && live[i - 1].offset + live[i - 1].size <= live[i].offset;
+  }
+  check(disjoint, "live allocations never overlap");
+
+  const MemoryStats churned = statsOf(tlsf);
+  std::printf("after churn: %zu allocations, %llu of %llu bytes used, %zu free ranges, "
+              "fragmentation %.3f\n",
+              churned.allocationCount,
+              static_cast<unsigned long long>(churned.bytesUsed),
+              static_cast<unsigned long long>(churned.bytesReserved),
+              churned.freeRangeCount,
+              churned.fragmentation());
+
+  for (const Live &allocation : live) {
+    tlsf.free(allocation.handle);
+  }
+  check(tlsf.freeRangeCount() == 1 && tlsf.largestFreeRange() == POOL_SIZE,
+        "everything merges back after churn");
+}
+
+int main() {
+  mergesOnFree();
+  alignsAndFails();
+  randomChurn();
+  std::printf("%s\n", failures == 0 ? "all passed" : "failed");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+// World bookkeeping: entities land in the archetype for their component set, destroy keeps the
+// dense rows packed by moving the last row in, and a recycled slot gets a new generation so the
+// old handle reads as dead. Views walk every matching archetype chunk by chunk.
+#include "World.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace kopi;
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+  if (!condition) {
+    std::printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static Transform2dComponent at(float x) {
+  Transform2dComponent transform{};
+  transform.translation = {x, 0.0f};
+  return transform;
+}
+
+static void createAndDestroy() {
+  World world;
+  const Entity body   = world.create(at(1.0f), RigidBody2dComponent{{}, 2.0f});
+  const Entity sample = world.create(at(2.0f), ColourComponent{}, FieldSampleComponent{});
+  check(world.size() == 2, "two entities alive");
+  check(world.archetypeCount() == 2, "one archetype per component set");
+  check(world.has<RigidBody2dComponent>(body) && !world.has<RigidBody2dComponent>(sample),
+        "components follow the archetype");
+  check(world.get<RigidBody2dComponent>(body).mass == 2.0f, "components keep their values");
+  check(world.get<Transform2dComponent>(sample).rotation == 0.0f, "rotation defaults to zero");
+
+  world.destroy(body);
+  check(!world.alive(body) && world.alive(sample), "destroy kills only its entity");
+  check(world.size() == 1, "one entity left");
+}
+
+static void destroyMovesLastRow() {
+  World world;
+  std::vector<Entity> entities;
+  for (int i = 0; i < 4; i++) {
+    entities.push_back(world.create(at(float(i)), RigidBody2dComponent{}));
+  }
+  // the last row moves into the hole, its handle must still find it
+  world.destroy(entities[1]);
+  check(world.get<Transform2dComponent>(entities[3]).translation.x == 3.0f, "moved row resolves");
+  check(world.get<Transform2dComponent>(entities[0]).translation.x == 0.0f, "rows before stay");
+  check(world.get<Transform2dComponent>(entities[2]).translation.x == 2.0f, "rows after stay");
+}
+
+static void generationalReuse() {
+  World world;
+  const Entity first = world.create(at(1.0f), RigidBody2dComponent{});
+  world.destroy(first);
+  const Entity second = world.create(at(2.0f), RigidBody2dComponent{});
+  check(second.index == first.index, "destroyed slot is recycled");
+  check(second.generation == first.generation + 1, "recycled slot bumps the generation");
+  check(!world.alive(first) && world.alive(second), "stale handle reads as dead");
+  check(!(first == second), "handles differ across generations");
+
+  world.destroy(second);
+  const Entity third = world.create(at(3.0f), ColourComponent{}, FieldSampleComponent{});
+  check(third.index == first.index && third.generation == first.generation + 2,
+        "slot reuse ignores the archetype");
+  check(world.get<Transform2dComponent>(third).translation.x == 3.0f, "new entity reads its own");
+}
+
+static void chunkIteration() {
+  World world;
+  const Entity first = world.create(at(1.0f), RigidBody2dComponent{});
+  world.create(at(2.0f), RigidBody2dComponent{});
+  world.create(at(10.0f), ColourComponent{}, FieldSampleComponent{});
+  world.create(at(20.0f), RigidBody2dComponent{}, ColourComponent{});
+
+  auto transforms = world.view<Transform2dComponent>();
+  check(transforms.size() == 4, "view counts every matching entity");
+  size_t chunks = 0;
+  float sum     = 0.0f;
+  for (auto chunk : transforms) {
+    chunks++;
+    auto column = chunk.get<Transform2dComponent>();
+    check(column.size() == chunk.size() && chunk.entities().size() == chunk.size(),
+          "chunk columns line up with its entities");
+    for (const auto &transform : column) {
+      sum += transform.translation.x;
+    }
+  }
+  check(chunks == 3, "one chunk per matching archetype");
+  check(sum == 33.0f, "chunks cover every entity once");
+
+  size_t bodies = 0;
+  world.view<Transform2dComponent, RigidBody2dComponent>().each(
+      [&](Transform2dComponent &, RigidBody2dComponent &) { bodies++; });
+  check(bodies == 3, "view matches supersets of its components");
+
+  // structural changes bump the version, writes to components do not
+  const uint64_t version = transforms.version();
+  world.get<Transform2dComponent>(first).translation.x = 5.0f;
+  check(world.view<Transform2dComponent>().version() == version, "writes keep the version");
+  world.create(at(3.0f), RigidBody2dComponent{});
+  check(world.view<Transform2dComponent>().version() != version, "create bumps the version");
+}
+
+int main() {
+  createAndDestroy();
+  destroyMovesLastRow();
+  generationalReuse();
+  chunkIteration();
+  std::printf("%s\n", failures == 0 ? "all passed" : "failed");
+  return failures == 0 ? 0 : 1;
+}